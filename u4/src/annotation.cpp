@@ -4,6 +4,8 @@
 
 #include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
  
+#include <algorithm>
+
 #include "annotation.h"
 
 #include "context.h"
@@ -23,8 +25,8 @@ Annotation::Annotation(const Coords &c, MapTile t, bool v, bool coverUp) :
     coords(c), 
     tile(t),
     visual(v),
-    ttl(-1),
-    coverUp(coverUp)
+    coverUp(coverUp),
+    expires(-1)
 {}
 
 /**
@@ -51,45 +53,53 @@ bool Annotation::operator==(const Annotation &a) const {
 /**
  * Constructors
  */ 
-AnnotationMgr::AnnotationMgr() {}
+AnnotationMgr::AnnotationMgr() : turn(0), count(0) {}
+
+AnnotationMgr::~AnnotationMgr() {
+    clear();
+}
 
 /**
  * Members
  */ 
 
 /**
- * Adds an annotation to the current map
+ * Adds an annotation to the current map.  If ttl isn't negative, the
+ * annotation is removed once that many more turns have passed.
  */
-Annotation *AnnotationMgr::add(Coords coords, MapTile tile, bool visual, bool isCoverUp) {
+Annotation *AnnotationMgr::add(Coords coords, MapTile tile, bool visual, bool isCoverUp, int ttl) {
+    Annotation *a = new Annotation(coords, tile, visual, isCoverUp);
+    Bucket &bucket = annotations[bucketIndex(coords)];
+
     /* new annotations go to the front so they're handled "on top" */
-    annotations.push_front(Annotation(coords, tile, visual, isCoverUp));
-    return &annotations.front();
+    bucket.insert(bucket.begin(), a);
+    count++;
+
+    if (ttl >= 0) {
+        a->expires = turn + ttl + 1;
+        expiring[a->expires % ANNOTATION_TTL_BUCKETS].push_back(a);
+    }
+    return a;
 }        
 
 /**
- * Returns all annotations found at the given map coordinates
+ * Returns a view of the annotations found at the given map coordinates
  */ 
-Annotation::List AnnotationMgr::allAt(Coords coords) {
-    Annotation::List list;
-
-    for (i = annotations.begin(); i != annotations.end(); i++) {
-        if (i->getCoords() == coords)
-            list.push_back(*i);
-    }
-    
-    return list;
+AnnotationMgr::View AnnotationMgr::at(const Coords &coords) const {
+    return View(annotations[bucketIndex(coords)], coords);
 }
 
 /**
- * Returns pointers to all annotations found at the given map coordinates
+ * Returns copies of all annotations found at the given map
+ * coordinates, for callers that add or remove annotations while
+ * going through them.
  */ 
-std::list<Annotation *> AnnotationMgr::ptrsToAllAt(Coords coords) {
-    std::list<Annotation *> list;
+Annotation::List AnnotationMgr::allAt(Coords coords) {
+    Annotation::List list;
+    View view = at(coords);
 
-    for (i = annotations.begin(); i != annotations.end(); i++) {
-        if (i->getCoords() == coords)
-            list.push_back(&(*i));
-    }
+    for (View::const_iterator i = view.begin(); i != view.end(); ++i)
+        list.push_back(**i);
     
     return list;
 }
@@ -98,7 +108,14 @@ std::list<Annotation *> AnnotationMgr::ptrsToAllAt(Coords coords) {
  * Removes all annotations on the map 
  */ 
 void AnnotationMgr::clear() {
-    annotations.clear();        
+    for (int i = 0; i < ANNOTATION_BUCKETS; i++) {
+        for (Bucket::iterator j = annotations[i].begin(); j != annotations[i].end(); j++)
+            delete *j;
+        annotations[i].clear();
+    }
+    for (int i = 0; i < ANNOTATION_TTL_BUCKETS; i++)
+        expiring[i].clear();
+    count = 0;
 }    
 
 /**
@@ -106,14 +123,20 @@ void AnnotationMgr::clear() {
  * annotations whose TTL has expired
  */ 
 void AnnotationMgr::passTurn() {
-    for (i = annotations.begin(); i != annotations.end(); i++) {
-        if (i->getTTL() == 0) {
-            i = annotations.erase(i);
-            if (i == annotations.end())
-                break;
+    Bucket &due = expiring[++turn % ANNOTATION_TTL_BUCKETS];
+    Bucket::iterator i = due.begin();
+
+    /* the wheel bucket also holds annotations due a full turn of the wheel later */
+    while (i != due.end()) {
+        if ((*i)->expires == turn) {
+            Annotation *a = *i;
+            Bucket &bucket = annotations[bucketIndex(a->getCoords())];
+
+            i = due.erase(i);
+            a->expires = -1;
+            remove(bucket, std::find(bucket.begin(), bucket.end(), a));
         }
-        else if (i->getTTL() > 0)
-            i->passTurn();
+        else i++;
     }
 }
 
@@ -126,9 +149,11 @@ void AnnotationMgr::remove(Coords coords, MapTile tile) {
 }
 
 void AnnotationMgr::remove(Annotation &a) {
-    for (i = annotations.begin(); i != annotations.end(); i++) {
-        if (*i == a) {
-            i = annotations.erase(i);
+    Bucket &bucket = annotations[bucketIndex(a.getCoords())];
+
+    for (Bucket::iterator i = bucket.begin(); i != bucket.end(); i++) {
+        if (**i == a) {
+            remove(bucket, i);
             break;
         }
     }
@@ -148,5 +173,26 @@ void AnnotationMgr::remove(Annotation::List l) {
  * Returns the number of annotations on the map
  */ 
 int AnnotationMgr::size() {
-    return annotations.size();
+    return count;
+}
+
+/**
+ * Removes and frees the annotation at the given place in its bucket,
+ * taking it off the expiry wheel first if it has a time to live.
+ */
+void AnnotationMgr::remove(Bucket &bucket, Bucket::iterator i) {
+    Annotation *a = *i;
+
+    if (a->expires >= 0) {
+        Bucket &due = expiring[a->expires % ANNOTATION_TTL_BUCKETS];
+        due.erase(std::find(due.begin(), due.end(), a));
+    }
+
+    bucket.erase(i);
+    delete a;
+    count--;
+}
+
+unsigned int AnnotationMgr::bucketIndex(const Coords &coords) {
+    return coords.hash() % ANNOTATION_BUCKETS;
 }
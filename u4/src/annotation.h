@@ -6,12 +6,16 @@
 #define ANNOTATION_H
 
 #include <list>
+#include <vector>
 
 #include "coords.h"
 #include "types.h"
 
 class Annotation;
 
+#define ANNOTATION_BUCKETS      64
+#define ANNOTATION_TTL_BUCKETS  32
+
 /**
  * Annotation are updates to a map.
  * There are three types of annotations:
@@ -31,40 +35,83 @@ public:
     const Coords& getCoords() const {return coords; } /**< Returns the coordinates of the annotation */
     MapTile& getTile()              {return tile;   } /**< Returns the annotation's tile */
     const bool isVisualOnly() const {return visual; } /**< Returns true for visual-only annotations */
-    const int getTTL() const        {return ttl;    } /**< Returns the number of turns the annotation has left to live */
     bool isCoverUp()                {return coverUp;}
 
     // Setters
-    void setCoords(const Coords &c) {coords = c;    } /**< Sets the coordinates for the annotation */
     void setTile(const MapTile &t)  {tile = t;      } /**< Sets the tile for the annotation */
     void setVisualOnly(bool v)      {visual = v;    } /**< Sets whether or not the annotation is visual-only */
-    void setTTL(int turns)          {ttl = turns;   } /**< Sets the number of turns the annotation will live */
-    void passTurn()                 {if (ttl > 0) ttl--; } /**< Passes a turn for the annotation */
 
     bool operator==(const Annotation&) const;    
 
     // Properties
 private:        
+    friend class AnnotationMgr;
+
     Coords coords;
     MapTile tile;        
     bool visual;
-    int ttl;
     bool coverUp;
-
+    long expires;   /**< the turn the annotation is removed on, or -1 if it lasts until removed */
 };
 
 /** 
  * Manages annotations for the current map.  This includes
  * adding and removing annotations, as well as finding annotations
  * and managing their existence.
+ *
+ * Annotations are kept in buckets hashed by their coordinates, newest
+ * first, so finding the annotations on a square only looks at the
+ * few that can be there.  Annotations with a time to live are also
+ * kept in a wheel of buckets by the turn they expire on, so passing
+ * a turn only looks at the ones expiring then.
  */
 class AnnotationMgr {    
+    typedef std::vector<Annotation *> Bucket;
+
 public:        
+    /**
+     * The annotations at one map square, newest first, iterated as
+     * pointers without copying them out.  A view is only good until
+     * annotations are next added or removed.
+     */
+    class View {
+    public:
+        class const_iterator {
+        public:
+            const_iterator() {}
+
+            Annotation *operator*() const                       {return *i;}
+            const_iterator &operator++()                        {++i; skip(); return *this;}
+            bool operator==(const const_iterator &o) const      {return i == o.i;}
+            bool operator!=(const const_iterator &o) const      {return i != o.i;}
+
+        private:
+            friend class View;
+            const_iterator(Bucket::const_iterator first, Bucket::const_iterator last, const Coords &c) :
+                i(first), end(last), coords(c) {skip();}
+            void skip()                                         {while (i != end && (*i)->getCoords() != coords) ++i;}
+
+            Bucket::const_iterator i, end;
+            Coords coords;
+        };
+
+        View(const Bucket &b, const Coords &c) : bucket(&b), coords(c) {}
+
+        const_iterator begin() const    {return const_iterator(bucket->begin(), bucket->end(), coords);}
+        const_iterator end() const      {return const_iterator(bucket->end(), bucket->end(), coords);}
+        bool empty() const              {return begin() == end();}
+
+    private:
+        const Bucket *bucket;
+        Coords coords;
+    };
+
     AnnotationMgr();
+    ~AnnotationMgr();
 
-    Annotation       *add(Coords coords, MapTile tile, bool visual = false, bool isCoverUp = false);
+    Annotation       *add(Coords coords, MapTile tile, bool visual = false, bool isCoverUp = false, int ttl = -1);
+    View             at(const Coords &pos) const;
     Annotation::List allAt(Coords pos);
-    std::list<Annotation *> ptrsToAllAt(Coords pos);
     void             clear();
     void             passTurn();
     void             remove(Coords pos, MapTile tile);
@@ -73,8 +120,13 @@ public:
     int              size();
 
 private:        
-    Annotation::List  annotations;
-    Annotation::List::iterator i;
+    void             remove(Bucket &bucket, Bucket::iterator i);
+    static unsigned int bucketIndex(const Coords &coords);
+
+    Bucket annotations[ANNOTATION_BUCKETS];
+    Bucket expiring[ANNOTATION_TTL_BUCKETS];
+    long turn;
+    int count;
 };
 
 #endif
@@ -15,6 +15,7 @@ public:
     virtual void init(Creature *m);
     virtual void begin();
     virtual void end(bool adjustKarma);
+    bool isKeyBufferable(int) const { return false; }
 
 private:
     bool heal();
@@ -26,6 +27,7 @@ public:
 
     virtual void begin();
     virtual void awardLoot();
+    bool isKeyBufferable(int) const { return false; }
 
 
 private:
@@ -51,7 +51,7 @@ Person *City::addPerson(Person *person) {
     p->setMap(this);
     p->goToStartLocation();
 
-    objects.push_back(p);    
+    appendObject(p);
     return p;
 }
 
@@ -46,6 +46,12 @@ vector<string> codexVirtueQuestions;
 vector<string> codexEndgameText1;
 vector<string> codexEndgameText2;
 
+static const char *codexImageNames[] = {
+    BKGD_HONESTY, BKGD_COMPASSN, BKGD_VALOR, BKGD_JUSTICE, 
+    BKGD_SACRIFIC, BKGD_HONOR, BKGD_SPIRIT, BKGD_HUMILITY,
+    BKGD_TRUTH, BKGD_LOVE, BKGD_COURAGE
+};
+
 /**
  * Initializes the Chamber of the Codex sequence (runs from codexStart())
  */
@@ -80,6 +86,12 @@ void codexDelete() {
 void codexStart() { 
     codexInit();  
 
+    /* decode the chamber's images in the background while it plays out */
+    vector<string> images(codexImageNames, codexImageNames + sizeof(codexImageNames) / sizeof(codexImageNames[0]));
+    images.push_back(BKGD_KEY);
+    images.push_back(BKGD_STONCRCL);
+    imageMgr->preload(images);
+
     /**
      * disable the whirlpool cursor and black out the screen
      */
@@ -284,12 +296,6 @@ void codexHandleWOP(const string &word) {
  * Handles naming of virtues in the Chamber of the Codex
  */
 void codexHandleVirtues(const string &virtue) {
-    static const char *codexImageNames[] = {
-        BKGD_HONESTY, BKGD_COMPASSN, BKGD_VALOR, BKGD_JUSTICE, 
-        BKGD_SACRIFIC, BKGD_HONOR, BKGD_SPIRIT, BKGD_HUMILITY,
-        BKGD_TRUTH, BKGD_LOVE, BKGD_COURAGE
-    };
-
     static int current = 0;
     static int tries = 1;
 
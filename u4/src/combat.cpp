@@ -25,6 +25,7 @@
 #include "object.h"
 #include "player.h"
 #include "portal.h"
+#include "profiler.h"
 #include "screen.h"
 #include "settings.h"
 #include "spell.h"
@@ -471,7 +472,7 @@ void CombatController::placePartyMembers() {
             /* add the party member to the map */
             p->setCoords(map->player_start[i]);
             p->setMap(map);
-            map->objects.push_back(p);
+            map->appendObject(p);
             party[i] = p;
         }
     }
@@ -679,6 +680,7 @@ bool CombatController::returnWeaponToOwner(const Coords &coords, int distance, i
 }
 
 void CombatController::finishTurn() {
+    PROFILE_ZONE("CombatController::finishTurn()");
     PartyMember *player = getCurrentPlayer();
     int quick;
 
@@ -1175,12 +1177,12 @@ PartyMemberVector CombatMap::getPartyMembers() {
  * NULL if otherwise.
  */ 
 PartyMember *CombatMap::partyMemberAt(Coords coords) {
-    PartyMemberVector party = getPartyMembers();
-    PartyMemberVector::iterator i;
+    const ObjectBucket &bucket = objectBucket(coords);
+    ObjectBucket::const_iterator i;
     
-    for (i = party.begin(); i != party.end(); i++) {
-        if ((*i)->getCoords() == coords)
-            return *i;
+    for (i = bucket.begin(); i != bucket.end(); i++) {
+        if (isPartyMember(i->obj) && i->obj->getCoords() == coords)
+            return dynamic_cast<PartyMember*>(i->obj);
     }
     return NULL;
 }
@@ -1190,12 +1192,12 @@ PartyMember *CombatMap::partyMemberAt(Coords coords) {
  * NULL if otherwise.
  */ 
 Creature *CombatMap::creatureAt(Coords coords) {
-    CreatureVector creatures = getCreatures();
-    CreatureVector::iterator i;
+    const ObjectBucket &bucket = objectBucket(coords);
+    ObjectBucket::const_iterator i;
 
-    for (i = creatures.begin(); i != creatures.end(); i++) {
-        if ((*i)->getCoords() == coords)            
-            return *i;
+    for (i = bucket.begin(); i != bucket.end(); i++) {
+        if (isCreature(i->obj) && !isPartyMember(i->obj) && i->obj->getCoords() == coords)
+            return dynamic_cast<Creature*>(i->obj);
     }
     return NULL;
 }
@@ -48,6 +48,7 @@ public:
 
     // Accessor Methods    
     bool          isCombatController() const { return true; }
+    bool          isKeyBufferable(int key) const { return key != U4_ESC; }
     bool          isCamping() const;
     bool          isWinOrLose() const;
     Direction     getExitDir() const;
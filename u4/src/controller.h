@@ -17,6 +17,8 @@ public:
 
     /* methods for interacting with event manager */
     virtual bool  isCombatController() const { return false; }
+    /** Returns true if a key typed while this controller is held up by a sleep or wait should be played back to it */
+    virtual bool  isKeyBufferable(int) const { return false; }
     bool notifyKeyPressed(int key);
     int getTimerInterval();
     static void timerCallback(void *data);
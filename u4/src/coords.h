@@ -16,6 +16,9 @@ public:
     
     bool operator==(const Coords &a) const { return x == a.x && y == a.y && z == a.z; }
     bool operator!=(const Coords &a) const { return !operator==(a); }
+
+    /** Returns a hash of the coordinates, for spreading points over buckets */
+    unsigned int hash() const { return (x * 73856093u) ^ (y * 19349663u) ^ (z * 83492791u); }
 };
 
 #endif /* COORDS_H */
@@ -111,9 +111,8 @@ unsigned char Dungeon::subTokenAt(MapCoords coords) {
 void dungeonSearch(void) {
     Dungeon *dungeon = dynamic_cast<Dungeon *>(c->location->map);
     DungeonToken token = dungeon->currentToken(); 
-    Annotation::List a = dungeon->annotations->allAt(c->location->coords);
     const ItemLocation *item;
-    if (a.size() > 0)
+    if (!dungeon->annotations->at(c->location->coords).empty())
         token = DUNGEON_CORRIDOR;
 
     screenMessage("Search...\n");
@@ -282,18 +281,15 @@ bool dungeonHandleTrap(TrapType trap) {
  * Returns true if a ladder-up is found at the given coordinates
  */
 bool Dungeon::ladderUpAt(MapCoords coords) {    
-    Annotation::List a = annotations->allAt(coords);
+    AnnotationMgr::View a = annotations->at(coords);
 
     if (tokenAt(coords) == DUNGEON_LADDER_UP ||
         tokenAt(coords) == DUNGEON_LADDER_UPDOWN)
         return true;
 
-    if (a.size() > 0) {
-        Annotation::List::iterator i;
-        for (i = a.begin(); i != a.end(); i++) {
-            if (i->getTile() == tileset->getByName("up_ladder")->getId())
-                return true;
-        }
+    for (AnnotationMgr::View::const_iterator i = a.begin(); i != a.end(); ++i) {
+        if ((*i)->getTile() == tileset->getByName("up_ladder")->getId())
+            return true;
     }
     return false;
 }
@@ -302,18 +298,15 @@ bool Dungeon::ladderUpAt(MapCoords coords) {
  * Returns true if a ladder-down is found at the given coordinates
  */
 bool Dungeon::ladderDownAt(MapCoords coords) {
-    Annotation::List a = annotations->allAt(coords);
+    AnnotationMgr::View a = annotations->at(coords);
 
     if (tokenAt(coords) == DUNGEON_LADDER_DOWN ||
         tokenAt(coords) == DUNGEON_LADDER_UPDOWN)
         return true;
 
-    if (a.size() > 0) {
-        Annotation::List::iterator i;
-        for (i = a.begin(); i != a.end(); i++) {
-            if (i->getTile() == tileset->getByName("down_ladder")->getId())
-                return true;
-        }
+    for (AnnotationMgr::View::const_iterator i = a.begin(); i != a.end(); ++i) {
+        if ((*i)->getTile() == tileset->getByName("down_ladder")->getId())
+            return true;
     }
     return false;
 }
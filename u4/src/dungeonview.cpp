@@ -18,6 +18,8 @@
 
 DungeonView::DungeonView(int x, int y, int columns, int rows) : TileView(x, y, rows, columns)
 , screen3dDungeonViewEnabled(true)
+, spriteScale(0)
+, frame(NULL)
 {
 }
 
@@ -37,57 +39,45 @@ void DungeonView::display(Context * c, TileView *view)
 
     /* 1st-person perspective */
     if (screen3dDungeonViewEnabled) {
-        //Note: This shouldn't go above 4, unless we check opaque tiles each step of the way.
-        const int farthest_non_wall_tile_visibility = 4;
-
-    	vector<MapTile> tiles;
+        /* nothing has changed since the last time, so just put that back */
+        std::vector<int> key;
+        bool reusable = getFrameKey(c, key);
+        if (reusable && frame && key == frameKey) {
+            frame->drawOn(this->screen, SCALED(this->x), SCALED(this->y));
+            return;
+        }
 
         screenEraseMapArea();
-        if (c->party->getTorchDuration() > 0) {
-            for (y = 3; y >= 0; y--) {
-                DungeonGraphicType type;
-
-                //FIXME: Maybe this should be in a loop
-				tiles = getTiles(y, -1);
-                type = tilesToGraphic(tiles);
-				drawWall(-1, y, (Direction)c->saveGame->orientation, type);
-
-				tiles = getTiles(y, 1);
-                type = tilesToGraphic(tiles);
-                drawWall(1, y, (Direction)c->saveGame->orientation, type);
-
-                tiles = getTiles(y, 0);
-                type = tilesToGraphic(tiles);
-                drawWall(0, y, (Direction)c->saveGame->orientation, type);
-
-                //This only checks that the tile at y==3 is opaque
-                if (y == 3 && !tiles.front().getTileType()->isOpaque())
-               	{
-               		for (int y_obj = farthest_non_wall_tile_visibility; y_obj > y; y_obj--)
-               		{
-               		vector<MapTile> distant_tiles = getTiles(y_obj     , 0);
-               		DungeonGraphicType distant_type = tilesToGraphic(distant_tiles);
-
-					if ((distant_type == DNGGRAPHIC_DNGTILE) || (distant_type == DNGGRAPHIC_BASETILE))
-						drawTile(c->location->map->tileset->get(distant_tiles.front().getId()),0, y_obj, Direction(c->saveGame->orientation));
-               		}
-               	}
-				if ((type == DNGGRAPHIC_DNGTILE) || (type == DNGGRAPHIC_BASETILE))
-					drawTile(c->location->map->tileset->get(tiles.front().getId()), 0, y, Direction(c->saveGame->orientation));
+        for (std::vector<DungeonViewItem>::const_iterator i = items.begin(); i != items.end(); i++) {
+            if (i->tile)
+                drawTile(i->tile, i->xoffset, i->distance, Direction(c->saveGame->orientation));
+            else
+                drawWall(i->xoffset, i->distance, Direction(c->saveGame->orientation), i->type);
+        }
+
+        if (reusable) {
+            if (!frame || frame->width() != int(SCALED(this->width)) || frame->height() != int(SCALED(this->height))) {
+                delete frame;
+                frame = Image::create(SCALED(this->width), SCALED(this->height), false, Image::HARDWARE);
+                frame->alphaOff();
             }
+            this->screen->drawSubRectOn(frame, 0, 0, SCALED(this->x), SCALED(this->y), SCALED(this->width), SCALED(this->height));
+            frameKey.swap(key);
         }
+        else
+            frameKey.clear();
     }
 
     /* 3rd-person perspective */
     else {
-    	vector<MapTile> tiles;
+    	TileStack tiles;
 
         static MapTile black = c->location->map->tileset->getByName("black")->getId();
         static MapTile avatar = c->location->map->tileset->getByName("avatar")->getId();
 
         for (y = 0; y < VIEWPORT_H; y++) {
             for (x = 0; x < VIEWPORT_W; x++) {
-                    tiles = getTiles((VIEWPORT_H / 2) - y, x - (VIEWPORT_W / 2));
+                    getTiles((VIEWPORT_H / 2) - y, x - (VIEWPORT_W / 2), tiles);
 
 				/* Only show blackness if there is no light */
 				if (c->party->getTorchDuration() <= 0)
@@ -102,8 +92,6 @@ void DungeonView::display(Context * c, TileView *view)
 }
 
 void DungeonView::drawInDungeon(Tile *tile, int x_offset, int distance, Direction orientation, bool tiledWall) {
-	Image *scaled;
-
   	const static int nscale_vga[] = { 12, 8, 4, 2, 1};
     const static int nscale_ega[] = { 8, 4, 2, 1, 0};
 
@@ -140,33 +128,30 @@ void DungeonView::drawInDungeon(Tile *tile, int x_offset, int distance, Directio
     }
     else
     {
-        tile->getImage()->drawOn(animated, 0, 0);
+        tile->drawOn(animated, 0, 0, 0);
     }
-    animated->makeBackgroundColorTransparent();
-    //This process involving the background color is only required for drawing in the dungeon.
-    //It will not play well with semi-transparent graphics.
 
     /* scale is based on distance; 1 means half size, 2 regular, 4 means scale by 2x, etc. */
     if (dscale[distance] == 0)
 		return;
-    else if (dscale[distance] == 1)
-        scaled = screenScaleDown(animated, 2);
-    else
-    {
-        scaled = screenScale(animated, dscale[distance] / 2, 1, 0);
-    }
+
+    Image *sprite = getSprite(tile, dscale[distance], tiledWall);
 
     if (tiledWall) {
-    	int i_x = SCALED((VIEWPORT_W * tileWidth  / 2.0) + this->x) - (scaled->width() / 2.0);
-    	int i_y = SCALED((VIEWPORT_H * tileHeight / 2.0) + this->y) - (scaled->height() / 2.0);
-    	int f_x = i_x + scaled->width();
-    	int f_y = i_y + scaled->height();
-    	int d_x = animated->width();
-    	int d_y = animated->height();
+    	/* tiled walls are drawn from the unscaled tile over the area the scaled tile would cover */
+    	int scaledWidth = dscale[distance] == 1 ? sprite->width() / 2 : sprite->width() * (dscale[distance] / 2);
+    	int scaledHeight = dscale[distance] == 1 ? sprite->height() / 2 : sprite->height() * (dscale[distance] / 2);
+
+    	int i_x = SCALED((VIEWPORT_W * tileWidth  / 2.0) + this->x) - (scaledWidth / 2.0);
+    	int i_y = SCALED((VIEWPORT_H * tileHeight / 2.0) + this->y) - (scaledHeight / 2.0);
+    	int f_x = i_x + scaledWidth;
+    	int f_y = i_y + scaledHeight;
+    	int d_x = sprite->width();
+    	int d_y = sprite->height();
 
     	for (int x = i_x; x < f_x; x+=d_x)
     		for (int y = i_y; y < f_y; y+=d_y)
-    			animated->drawSubRectOn(this->screen,
+    			sprite->drawSubRectOn(this->screen,
     					x,
     					y,
     					0,
@@ -177,10 +162,10 @@ void DungeonView::drawInDungeon(Tile *tile, int x_offset, int distance, Directio
     }
     else {
     	int y_offset = std::max(0,(dscale[distance] - offset_adj) * offset_multiplier);
-    	int x = SCALED((VIEWPORT_W * tileWidth / 2.0) + this->x) - (scaled->width() / 2.0);
-    	int y = SCALED((VIEWPORT_H * tileHeight / 2.0) + this->y + y_offset) - (scaled->height() / 8.0);
+    	int x = SCALED((VIEWPORT_W * tileWidth / 2.0) + this->x) - (sprite->width() / 2.0);
+    	int y = SCALED((VIEWPORT_H * tileHeight / 2.0) + this->y + y_offset) - (sprite->height() / 8.0);
 
-		scaled->drawSubRectOn(	this->screen,
+		sprite->drawSubRectOn(	this->screen,
 								x,
 								y,
 								0,
@@ -188,8 +173,150 @@ void DungeonView::drawInDungeon(Tile *tile, int x_offset, int distance, Directio
 								SCALED(tileWidth * VIEWPORT_W + this->x) - x ,
 								SCALED(tileHeight * VIEWPORT_H + this->y) - y );
     }
+}
+
+/**
+ * Returns the tile drawn on the animated scratchpad, with its
+ * background made transparent and, unless it is a tiled wall, scaled
+ * for the given distance.  These are kept, so the same tile seen from
+ * the same distance again only needs to be blitted.  The cache is
+ * keyed by the pixels on the scratchpad, so every frame of an
+ * animation is kept apart and a reloaded tileset never shows stale
+ * images.
+ */
+Image *DungeonView::getSprite(Tile *tile, int dscale, bool tiled) {
+    if (spriteScale != settings.scale || sprites.size() >= DUNGEON_SPRITE_CACHE_SIZE) {
+        flushSprites();
+        spriteScale = settings.scale;
+    }
+
+    /* FNV-1a over the scratchpad's pixel rows */
+    uint64_t hash = 14695981039346656037ULL;
+    {
+        ImageLock lock(animated);
+        int rowSize = animated->width() * animated->bytesPerPixel();
+        for (int y = 0; y < animated->height(); y++) {
+            const uint8_t *row = animated->getRow8(y);
+            for (int i = 0; i < rowSize; i++)
+                hash = (hash ^ row[i]) * 1099511628211ULL;
+        }
+    }
+
+    DungeonSpriteKey key(tile->getId(), dscale, tiled, hash);
+    std::map<DungeonSpriteKey, Image *>::iterator i = sprites.find(key);
+    if (i != sprites.end())
+        return i->second;
 
-    delete scaled;
+    animated->makeBackgroundColorTransparent();
+    //This process involving the background color is only required for drawing in the dungeon.
+    //It will not play well with semi-transparent graphics.
+
+    Image *sprite;
+    if (tiled)
+        sprite = Image::duplicate(animated);
+    else if (dscale == 1)
+        sprite = screenScaleDown(animated, 2);
+    else
+        sprite = screenScale(animated, dscale / 2, 1, 0);
+
+    sprites[key] = sprite;
+    return sprite;
+}
+
+/**
+ * Works out what the 1st-person view shows, in the order it is drawn,
+ * and fills in a key that changes whenever the picture would.  Returns
+ * false if the picture changes by itself, because an animated tile is
+ * in view.
+ */
+bool DungeonView::getFrameKey(Context *c, std::vector<int> &key) {
+    //Note: This shouldn't go above 4, unless we check opaque tiles each step of the way.
+    const int farthest_non_wall_tile_visibility = 4;
+
+    TileStack tiles;
+    bool reusable = true;
+
+    items.clear();
+    if (c->party->getTorchDuration() > 0) {
+        for (int y = 3; y >= 0; y--) {
+            DungeonViewItem item;
+            item.distance = y;
+            item.tile = NULL;
+
+            //FIXME: Maybe this should be in a loop
+            getTiles(y, -1, tiles);
+            item.xoffset = -1;
+            item.type = tilesToGraphic(tiles);
+            items.push_back(item);
+
+            getTiles(y, 1, tiles);
+            item.xoffset = 1;
+            item.type = tilesToGraphic(tiles);
+            items.push_back(item);
+
+            getTiles(y, 0, tiles);
+            item.xoffset = 0;
+            item.type = tilesToGraphic(tiles);
+            items.push_back(item);
+
+            //This only checks that the tile at y==3 is opaque
+            if (y == 3 && !tiles.front().getTileType()->isOpaque()) {
+                for (int y_obj = farthest_non_wall_tile_visibility; y_obj > y; y_obj--) {
+                    TileStack distant_tiles;
+                    getTiles(y_obj, 0, distant_tiles);
+                    DungeonGraphicType distant_type = tilesToGraphic(distant_tiles);
+
+                    if ((distant_type == DNGGRAPHIC_DNGTILE) || (distant_type == DNGGRAPHIC_BASETILE)) {
+                        DungeonViewItem distant = { 0, y_obj, distant_type, c->location->map->tileset->get(distant_tiles.front().getId()) };
+                        items.push_back(distant);
+                    }
+                }
+            }
+            if ((item.type == DNGGRAPHIC_DNGTILE) || (item.type == DNGGRAPHIC_BASETILE)) {
+                item.tile = c->location->map->tileset->get(tiles.front().getId());
+                items.push_back(item);
+            }
+        }
+    }
+
+    key.push_back(c->location->map->id);
+    key.push_back(c->location->coords.x);
+    key.push_back(c->location->coords.y);
+    key.push_back(c->location->coords.z);
+    key.push_back(c->saveGame->orientation);
+    key.push_back(c->party->getTorchDuration() > 0);
+    for (std::vector<DungeonViewItem>::const_iterator i = items.begin(); i != items.end(); i++) {
+        key.push_back(i->xoffset);
+        key.push_back(i->distance);
+        key.push_back(i->type);
+        key.push_back(i->tile ? int(i->tile->getId()) : -1);
+        if (i->tile && i->tile->getAnim())
+            reusable = false;
+    }
+
+    return reusable;
+}
+
+/**
+ * Throws away everything the view keeps from one draw to the next.
+ * Called when the screen is set up again, since the tiles and walls
+ * may look different afterwards.
+ */
+void DungeonView::clearCaches() {
+    flushSprites();
+    flushCells();
+    delete frame;
+    frame = NULL;
+    frameKey.clear();
+}
+
+/**
+ * Throws away all the sprites made by getSprite().
+ */
+void DungeonView::flushSprites() {
+    for (std::map<DungeonSpriteKey, Image *>::iterator i = sprites.begin(); i != sprites.end(); i++)
+        delete i->second;
+    sprites.clear();
 }
 
 int DungeonView::graphicIndex(int xoffset, int distance, Direction orientation, DungeonGraphicType type) {
@@ -234,7 +361,7 @@ void DungeonView::drawTile(Tile *tile, int x_offset, int distance, Direction ori
 	DungeonViewer.drawInDungeon(tile, x_offset, distance, orientation, tile->isTiledInDungeon());
 }
 
-std::vector<MapTile> DungeonView::getTiles(int fwd, int side) {
+void DungeonView::getTiles(int fwd, int side, TileStack &tiles) {
     MapCoords coords = c->location->coords;
 
     switch (c->saveGame->orientation) {
@@ -268,10 +395,10 @@ std::vector<MapTile> DungeonView::getTiles(int fwd, int side) {
     coords.wrap(c->location->map);
 
     bool focus;
-    return c->location->tilesAt(coords, focus);
+    c->location->tilesAt(coords, focus, tiles);
 }
 
-DungeonGraphicType DungeonView::tilesToGraphic(const std::vector<MapTile> &tiles) {
+DungeonGraphicType DungeonView::tilesToGraphic(const TileStack &tiles) {
     MapTile tile = tiles.front();
 
     static const MapTile corridor = c->location->map->tileset->getByName("brick_floor")->getId();
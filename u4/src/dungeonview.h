@@ -17,6 +17,9 @@
 #include "types.h"
 #include "location.h"
 
+#include <map>
+#include <vector>
+
 typedef enum {
     DNGGRAPHIC_NONE,
     DNGGRAPHIC_WALL,
@@ -28,11 +31,47 @@ typedef enum {
     DNGGRAPHIC_BASETILE
 } DungeonGraphicType;
 
-std::vector<MapTile> dungeonViewGetTiles(int fwd, int side);
-DungeonGraphicType dungeonViewTilesToGraphic(const std::vector<MapTile> &tiles);
+void dungeonViewGetTiles(int fwd, int side, TileStack &tiles);
+DungeonGraphicType dungeonViewTilesToGraphic(const TileStack &tiles);
 
 #define DungeonViewer (*DungeonView::getInstance())
 
+#define DUNGEON_SPRITE_CACHE_SIZE 256
+
+/**
+ * Identifies a tile drawn in the 1st-person view at one size.  The
+ * hash is of the pixels the tile was drawn with, so an animated tile
+ * gets an entry for each look it takes on.
+ */
+struct DungeonSpriteKey {
+    DungeonSpriteKey(TileId tile, int scale, bool tiled, uint64_t hash) :
+        tile(tile), scale(scale), tiled(tiled), hash(hash) {}
+
+    bool operator<(const DungeonSpriteKey &k) const {
+        if (hash != k.hash)
+            return hash < k.hash;
+        if (tile != k.tile)
+            return tile < k.tile;
+        if (scale != k.scale)
+            return scale < k.scale;
+        return tiled < k.tiled;
+    }
+
+    TileId tile;
+    int scale;
+    bool tiled;
+    uint64_t hash;
+};
+
+/**
+ * A wall or tile to be drawn in the 1st-person view.
+ */
+struct DungeonViewItem {
+    int xoffset, distance;
+    DungeonGraphicType type;
+    Tile *tile;                 /**< the tile to draw, or NULL for a wall */
+};
+
 /**
  * @todo
  * <ul>
@@ -42,7 +81,17 @@ DungeonGraphicType dungeonViewTilesToGraphic(const std::vector<MapTile> &tiles);
 class DungeonView : public TileView {
 private:
     DungeonView(int x, int y, int columns, int rows);
+    Image *getSprite(Tile *tile, int dscale, bool tiled);
+    void flushSprites();
+    bool getFrameKey(Context *c, std::vector<int> &key);
+
     bool screen3dDungeonViewEnabled;
+    std::map<DungeonSpriteKey, Image *> sprites;    /**< tiles already made transparent and scaled, see getSprite() */
+    unsigned int spriteScale;                       /**< the screen scale the sprites were made at */
+
+    std::vector<DungeonViewItem> items;     /**< what the 1st-person view shows, farthest first */
+    std::vector<int> frameKey;              /**< describes the view held in frame */
+    Image *frame;                           /**< the last 1st-person view drawn, if it can be reused */
 public:
     static DungeonView * instance;
     static DungeonView * getInstance();
@@ -53,11 +102,12 @@ public:
     void drawWall(int xoffset, int distance, Direction orientation, DungeonGraphicType type);
 
     void display(Context * c, TileView *view);
-    DungeonGraphicType tilesToGraphic(const std::vector<MapTile> &tiles);
+    DungeonGraphicType tilesToGraphic(const TileStack &tiles);
 
     bool toggle3DDungeonView(){return screen3dDungeonViewEnabled=!screen3dDungeonViewEnabled;}
+    void clearCaches();
 
-    std::vector<MapTile> getTiles(int fwd, int side);
+    void getTiles(int fwd, int side, TileStack &tiles);
 };
 
 
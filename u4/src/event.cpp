@@ -89,6 +89,14 @@ Controller *EventHandler::popController() {
     getTimer()->remove(&Controller::timerCallback, controller);
     controllers.pop_back();
 
+    /* keys kept for it have nowhere to go now */
+    for (std::deque<TypedKey>::iterator i = typeAhead.begin(); i != typeAhead.end();) {
+        if (i->controller == controller)
+            i = typeAhead.erase(i);
+        else
+            i++;
+    }
+
     return getController();
 }
 
@@ -102,99 +110,183 @@ Controller *EventHandler::getController() const {
 
 void EventHandler::setController(Controller *c) {
     while (popController() != NULL) {}
+    clearTypeAhead();
     pushController(c);
 }
 
+/**
+ * Holds on to a key typed while input is held up by a sleep or a
+ * wait, so that run() can hand it on once input resumes.  The
+ * controller being held up decides which keys are worth keeping, and
+ * the key is only ever handed to that controller.  Lone modifier keys,
+ * and keys typed once the queue is full, are dropped.  Returns true if
+ * the key was kept.
+ */
+bool EventHandler::bufferKey(int key) {
+    if (key >= U4_RIGHT_SHIFT && key <= U4_LEFT_META)
+        return false;
+    if (typeAhead.size() >= EVENT_TYPEAHEAD_MAX)
+        return false;
+
+    /* waits stand in for the controller they hold up */
+    Controller *controller = NULL;
+    for (vector<Controller *>::reverse_iterator i = controllers.rbegin(); i != controllers.rend(); i++) {
+        if (!dynamic_cast<WaitController *>(*i)) {
+            controller = *i;
+            break;
+        }
+    }
+    if (!controller || !controller->isKeyBufferable(key))
+        return false;
+
+    TypedKey typed;
+    typed.key = key;
+    typed.controller = controller;
+    typeAhead.push_back(typed);
+    return true;
+}
+
+/**
+ * Forgets any keys typed ahead.
+ */
+void EventHandler::clearTypeAhead() {
+    typeAhead.clear();
+}
+
 
 /* TimedEvent functions */
 TimedEvent::TimedEvent(TimedEvent::Callback cb, int i, void *d) :
     callback(cb),
     data(d),
-    interval(i),
-    current(0)
+    interval(i > 0 ? i : 1),    /* shorter intervals fire every tick */
+    deadline(0),
+    heapIndex(-1)
 {}
 
 TimedEvent::Callback TimedEvent::getCallback() const    { return callback; }
 void *TimedEvent::getData()                             { return data; }
 
 /**
- * Advances the timed event forward a tick.
- * When (current >= interval), then it executes its callback function.
+ * Adds a timed event to the event queue.  The event first fires
+ * 'interval' ticks from now.  The event returned can be used to
+ * remove it again.
  */
-void TimedEvent::tick() {
-    if (++current >= interval) {
-        (*callback)(data);
-        current = 0;
-    }
-}
+TimedEvent *TimedEventMgr::add(TimedEvent::Callback callback, int interval, void *data) {
+    TimedEvent *event = new TimedEvent(callback, interval, data);
+    event->deadline = now() + event->interval * baseInterval;
 
-/**
- * Returns true if the event queue is locked
- */
-bool TimedEventMgr::isLocked() const {
-    return locked;
-}
+    heap.push_back(event);
+    place(event, heap.size() - 1);
+    siftUp(event->heapIndex);
+    byData.insert(DataMap::value_type(data, event));
 
-/**
- * Adds a timed event to the event queue.
- */
-void TimedEventMgr::add(TimedEvent::Callback callback, int interval, void *data) {
-    events.push_back(new TimedEvent(callback, interval, data));
+    if (event->heapIndex == 0)
+        schedule();
+    return event;
 }
 
 /**
- * Removes a timed event from the event queue.
+ * Removes a timed event from the event queue.  This is safe to do
+ * from within an event's callback, even for the event itself.
  */
-TimedEventMgr::List::iterator TimedEventMgr::remove(List::iterator i) {
-    if (isLocked()) {
-        deferredRemovals.push_back(*i);
-        return i;
-    }
-    else {
-        delete *i;
-        return events.erase(i);
-    }
-}
-
 void TimedEventMgr::remove(TimedEvent* event) {
-    List::iterator i;
-    for (i = events.begin(); i != events.end(); i++) {
-        if ((*i) == event) {
-            remove(i);
+    int index = event->heapIndex;
+    ASSERT(index >= 0 && index < (int) heap.size() && heap[index] == event, "timed event not in the queue");
+
+    std::pair<DataMap::iterator, DataMap::iterator> range = byData.equal_range(event->getData());
+    for (DataMap::iterator i = range.first; i != range.second; i++) {
+        if (i->second == event) {
+            byData.erase(i);
             break;
         }
     }
+
+    TimedEvent *last = heap.back();
+    heap.pop_back();
+    if (last != event) {
+        place(last, index);
+        siftUp(index);
+        siftDown(last->heapIndex);
+    }
+
+    delete event;
 }
 
 void TimedEventMgr::remove(TimedEvent::Callback callback, void *data) {
-    List::iterator i;
-    for (i = events.begin(); i != events.end(); i++) {
-        if ((*i)->getCallback() == callback && (*i)->getData() == data) {
-            remove(i);
+    std::pair<DataMap::iterator, DataMap::iterator> range = byData.equal_range(data);
+    for (DataMap::iterator i = range.first; i != range.second; i++) {
+        if (i->second->getCallback() == callback) {
+            remove(i->second);
             break;
         }
     }
 }
 
 /**
- * Runs each of the callback functions of the TimedEvents associated with this manager.
+ * Runs the callback functions of the TimedEvents that are due.  Each
+ * runs at most once per call; one that has fallen more than a whole
+ * interval behind skips the ticks it missed rather than firing for
+ * each of them.
  */
 void TimedEventMgr::tick() {
-    List::iterator i;
-    lock();
-    
-    for (i = events.begin(); i != events.end(); i++)
-        (*i)->tick();   
+    unsigned int time = now();
+
+    while (!heap.empty() && int(heap[0]->deadline - time) <= 0) {
+        TimedEvent *event = heap[0];
+        unsigned int period = event->interval * baseInterval;
+
+        /* move the event on before running it, as the callback may remove it */
+        event->deadline += period;
+        if (int(event->deadline - time) <= 0)
+            event->deadline = time + period;
+        siftDown(0);
+
+        (*event->callback)(event->data);
+    }
+
+    schedule();
+}
+
+/**
+ * Returns true if event a is due before event b.
+ */
+bool TimedEventMgr::before(const TimedEvent *a, const TimedEvent *b) const {
+    return int(a->deadline - b->deadline) < 0;
+}
 
-    unlock();
+void TimedEventMgr::place(TimedEvent *event, int index) {
+    heap[index] = event;
+    event->heapIndex = index;
+}
 
-    // Remove events that have been deferred for removal
-    for (i = deferredRemovals.begin(); i != deferredRemovals.end(); i++)
-        events.remove(*i);
+void TimedEventMgr::siftUp(int index) {
+    TimedEvent *event = heap[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!before(event, heap[parent]))
+            break;
+        place(heap[parent], index);
+        index = parent;
+    }
+    place(event, index);
 }
 
-void TimedEventMgr::lock()      { locked = true; }
-void TimedEventMgr::unlock()    { locked = false; }
+void TimedEventMgr::siftDown(int index) {
+    int n = heap.size();
+    TimedEvent *event = heap[index];
+    while (true) {
+        int child = index * 2 + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && before(heap[child + 1], heap[child]))
+            child++;
+        if (!before(heap[child], event))
+            break;
+        place(heap[child], index);
+        index = child;
+    }
+    place(event, index);
+}
 
 void EventHandler::pushMouseAreaSet(MouseArea *mouseAreas) {
     mouseAreaSets.push_front(mouseAreas);
@@ -389,6 +481,7 @@ void WaitController::timerFired() {
 }
 
 bool WaitController::keyPressed(int key) {
+    eventHandler->bufferKey(key);
     return true;
 }
 
@@ -5,7 +5,9 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include <deque>
 #include <list>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -38,6 +40,8 @@ using std::string;
 #define U4_RIGHT_META   309
 #define U4_LEFT_META    310
 
+#define EVENT_TYPEAHEAD_MAX 8
+
 extern int eventTimerGranularity;
 
 struct _MouseArea;
@@ -167,8 +171,9 @@ public:
 };
 
 /**
- * A controller to pause for a given length of time, ignoring all
- * keyboard input.
+ * A controller to pause for a given length of time.  Keys typed in
+ * the meantime are kept for the controller underneath, if it wants
+ * them.
  */
 class WaitController : public Controller {
 public:
@@ -185,12 +190,12 @@ private:
 };
 
 /**
- * A class for handling timed events.
+ * A class for handling timed events.  Each event fires every
+ * 'interval' ticks of its manager's base interval.
  */ 
 class TimedEvent {
 public:
     /* Typedefs */
-    typedef std::list<TimedEvent*> List;
     typedef void (*Callback)(void *);
 
     /* Constructors */
@@ -199,14 +204,16 @@ public:
     /* Member functions */
     Callback getCallback() const;
     void *getData();
-    void tick();
     
     /* Properties */
 protected:    
+    friend class TimedEventMgr;
+
     Callback callback;
     void *data;
     int interval;
-    int current;
+    unsigned int deadline;  /**< when the event fires next, in milliseconds on the manager's clock */
+    int heapIndex;          /**< where the event is in its manager's heap */
 };
 
 #if defined(IOS)
@@ -221,13 +228,13 @@ typedef void *UIEvent;
 
 
 /**
- * A class for managing timed events
+ * A class for managing timed events.  The events are kept in a heap
+ * ordered by when they are next due, and the manager only asks to be
+ * woken up when the earliest of them is.  A manager with no events
+ * never wakes up at all.
  */ 
 class TimedEventMgr {
 public:
-    /* Typedefs */
-    typedef TimedEvent::List List;    
-
     /* Constructors */
     TimedEventMgr(int baseInterval);
     ~TimedEventMgr();
@@ -236,10 +243,7 @@ public:
     static unsigned int callback(unsigned int interval, void *param);
 
     /* Member functions */
-    bool isLocked() const;      /**< Returns true if the event list is locked (in use) */    
-
-    void add(TimedEvent::Callback callback, int interval, void *data = NULL);
-    List::iterator remove(List::iterator i);
+    TimedEvent *add(TimedEvent::Callback callback, int interval, void *data = NULL);
     void remove(TimedEvent* event);
     void remove(TimedEvent::Callback callback, void *data = NULL);
     void tick();
@@ -252,8 +256,14 @@ public:
 #endif
 
 private:
-    void lock();                /**< Locks the event list */
-    void unlock();              /**< Unlocks the event list */
+    typedef std::multimap<void *, TimedEvent *> DataMap;
+
+    static unsigned int now();  /**< Returns the time on a clock that never goes back, in milliseconds */
+    void schedule();            /**< Asks to be woken up when the earliest event is due */
+    bool before(const TimedEvent *a, const TimedEvent *b) const;
+    void place(TimedEvent *event, int index);
+    void siftUp(int index);
+    void siftDown(int index);
 
     /* Properties */
 protected:
@@ -262,9 +272,8 @@ protected:
 
     void *id;
     int baseInterval;
-    bool locked;
-    List events;
-    List deferredRemovals;
+    std::vector<TimedEvent *> heap;     /**< the events, earliest deadline first */
+    DataMap byData;                     /**< the events, by the data passed to their callbacks */
 #if defined(IOS)
     TimedManagerHelper *m_helper;
 #endif
@@ -316,6 +325,10 @@ public:
     KeyHandler *getKeyHandler() const;
     void setKeyHandler(KeyHandler kh);
 
+    /* Type-ahead functions */
+    bool bufferKey(int key);
+    void clearTypeAhead();
+
     /* Mouse area functions */
     void pushMouseAreaSet(_MouseArea *mouseAreas);
     void popMouseAreaSet();
@@ -330,6 +343,13 @@ protected:
     MouseAreaList mouseAreaSets;
     updateScreenCallback updateScreen;
 
+    /** A key typed while input was held up, and the controller that kept it */
+    struct TypedKey {
+        int key;
+        Controller *controller;
+    };
+    std::deque<TypedKey> typeAhead; /**< keys typed while input was held up, oldest first */
+
 private:
     static EventHandler *instance;
 };
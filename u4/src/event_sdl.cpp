@@ -5,6 +5,7 @@
 #include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
 
 #include <SDL.h>
+#include <typeinfo>
 #include "u4.h"
 
 #include "event.h"
@@ -12,6 +13,7 @@
 #include "context.h"
 #include "debug.h"
 #include "error.h"
+#include "latency.h"
 #include "screen.h"
 #include "settings.h"
 #include "u4_sdl.h"
@@ -19,6 +21,13 @@
 extern bool verbose, quit;
 extern int eventTimerGranularity;
 
+/*
+ * How many times EventHandler::run() has been entered.  An input whose
+ * handling enters it again has opened a prompt, and its latency would
+ * include however long the player took to answer, so it isn't timed.
+ */
+static unsigned int eventLoopsEntered = 0;
+
 KeyHandler::KeyHandler(Callback func, void *d, bool asyncronous) :
     handler(func),
     async(asyncronous),
@@ -50,6 +59,11 @@ bool KeyHandler::globalHandler(int key) {
         quit = true;
         EventHandler::end();
         return true;
+    case U4_ALT + 'l': /* Alt+l */
+        if (!latencyTracer->isEnabled())
+            return false;
+        latencyTracer->write();
+        return true;
     default: return false;
     }
 }
@@ -141,18 +155,17 @@ KeyHandler *KeyHandlerController::getKeyHandler() {
 
 /**
  * Constructs a timed event manager object.
- * Adds a timer callback to the SDL subsystem, which
- * will drive all of the timed events that this object
- * controls.
+ * Makes sure the SDL timer subsystem, which will wake up the event
+ * loop whenever one of the events this object controls is due, is
+ * running.
  */
-TimedEventMgr::TimedEventMgr(int i) : baseInterval(i) {
+TimedEventMgr::TimedEventMgr(int i) : id(NULL), baseInterval(i) {
     /* start the SDL timer */    
     if (instances == 0) {
         if (u4_SDL_InitSubSystem(SDL_INIT_TIMER) < 0)
             errorFatal("unable to init SDL: %s", SDL_GetError());
     }
 
-    id = static_cast<void*>(SDL_AddTimer(i, &TimedEventMgr::callback, this));
     instances++;
 }
 
@@ -163,8 +176,10 @@ TimedEventMgr::TimedEventMgr(int i) : baseInterval(i) {
  * objects.
  */
 TimedEventMgr::~TimedEventMgr() {
-    SDL_RemoveTimer(static_cast<SDL_TimerID>(id));
-    id = NULL;
+    stop();
+
+    for (std::vector<TimedEvent *>::iterator i = heap.begin(); i != heap.end(); i++)
+        delete *i;
     
     if (instances == 1)
         u4_SDL_QuitSubSystem(SDL_INIT_TIMER);
@@ -174,7 +189,8 @@ TimedEventMgr::~TimedEventMgr() {
 }
 
 /**
- * Adds an SDL timer event to the message queue.
+ * Adds an SDL timer event to the message queue.  The timer keeps
+ * going until tick() replaces it with one for the next deadline.
  */
 unsigned int TimedEventMgr::callback(unsigned int interval, void *param) {
     SDL_Event event;
@@ -188,10 +204,33 @@ unsigned int TimedEventMgr::callback(unsigned int interval, void *param) {
     return interval;
 }
 
+unsigned int TimedEventMgr::now() {
+    return SDL_GetTicks();
+}
+
 /**
- * Re-initializes the timer manager to a new timer granularity
+ * Replaces the SDL timer with one that goes off when the earliest
+ * event is due, or with none at all if there are no events.
+ */
+void TimedEventMgr::schedule() {
+    stop();
+    start();
+}
+
+/**
+ * Re-initializes the timer manager to a new timer granularity.  Every
+ * event keeps the number of ticks it had left, which also keeps them
+ * in the same order.
  */ 
 void TimedEventMgr::reset(unsigned int interval) {
+    unsigned int time = now();
+
+    for (std::vector<TimedEvent *>::iterator i = heap.begin(); i != heap.end(); i++) {
+        int left = int((*i)->deadline - time);
+        int ticks = left > 0 ? (left + baseInterval - 1) / baseInterval : 0;
+        (*i)->deadline = time + ticks * interval;
+    }
+
     baseInterval = interval;
     stop();
     start();    
@@ -205,8 +244,10 @@ void TimedEventMgr::stop() {
 }
 
 void TimedEventMgr::start() {
-    if (!id)
-        id = static_cast<void*>(SDL_AddTimer(baseInterval, &TimedEventMgr::callback, this));
+    if (!id && !heap.empty()) {
+        int delay = int(heap[0]->deadline - now());
+        id = static_cast<void*>(SDL_AddTimer(delay > 1 ? delay : 1, &TimedEventMgr::callback, this));
+    }
 }
 
 /**
@@ -233,6 +274,7 @@ static void handleActiveEvent(const SDL_Event &event, updateScreenCallback updat
         if (event.active.gain) {
             if (updateScreen)
                 (*updateScreen)();
+            screenDamageAll();
             screenRedrawScreen();
         }                
     }
@@ -249,14 +291,24 @@ static void handleMouseButtonDownEvent(const SDL_Event &event, Controller *contr
     MouseArea *area = eventHandler->mouseAreaForPoint(event.button.x, event.button.y);
     if (!area || area->command[button] == 0)
         return;
+
+    const char *controllerType = typeid(*controller).name();
+    unsigned int loops = eventLoopsEntered;
+    LatencyTime received = LatencyTracer::now();
     controller->keyPressed(area->command[button]);            
+    LatencyTime handled = LatencyTracer::now();
     if (updateScreen)
         (*updateScreen)();
+    LatencyTime updated = LatencyTracer::now();
     screenRedrawScreen();
+    if (loops == eventLoopsEntered)
+        latencyTracer->record(controllerType, received, handled, updated, LatencyTracer::now());
 }
 
-static void handleKeyDownEvent(const SDL_Event &event, Controller *controller, updateScreenCallback updateScreen) {
-    int processed;
+/**
+ * Translates a key event into the key code passed to controllers.
+ */
+static int translateKeyDownEvent(const SDL_Event &event) {
     int key;
     
     if (event.key.keysym.unicode != 0)
@@ -298,13 +350,26 @@ static void handleKeyDownEvent(const SDL_Event &event, Controller *controller, u
                event.key.keysym.mod, 
                key);
     
+    return key;
+}
+
+static void handleKey(int key, Controller *controller, updateScreenCallback updateScreen) {
+    /* the controller may be gone by the time the key has been handled */
+    const char *controllerType = typeid(*controller).name();
+    unsigned int loops = eventLoopsEntered;
+    LatencyTime received = LatencyTracer::now();
+
     /* handle the keypress */
-    processed = controller->notifyKeyPressed(key);
+    int processed = controller->notifyKeyPressed(key);
     
     if (processed) {
+        LatencyTime handled = LatencyTracer::now();
         if (updateScreen)
             (*updateScreen)();
+        LatencyTime updated = LatencyTracer::now();
         screenRedrawScreen();
+        if (loops == eventLoopsEntered)
+            latencyTracer->record(controllerType, received, handled, updated, LatencyTracer::now());
     }
     
 }
@@ -323,6 +388,8 @@ static Uint32 sleepTimerCallback(Uint32 interval, void *) {
  * Delays program execution for the specified number of milliseconds.
  * This doesn't actually stop events, but it stops the user from interacting
  * While some important event happens (e.g., getting hit by a cannon ball or a spell effect).
+ * Keys typed in the meantime are kept in the type-ahead queue, if the
+ * current controller wants them.
  */
 void EventHandler::sleep(unsigned int usec) {
     // Start a timer for the amount of time we want to sleep from user input.
@@ -337,6 +404,8 @@ void EventHandler::sleep(unsigned int usec) {
         default:
             break;
         case SDL_KEYDOWN:
+            eventHandler->bufferKey(translateKeyDownEvent(event));
+            break;
         case SDL_KEYUP:
         case SDL_MOUSEBUTTONDOWN:
         case SDL_MOUSEBUTTONUP:
@@ -364,6 +433,8 @@ void EventHandler::sleep(unsigned int usec) {
 }
 
 void EventHandler::run() {
+    eventLoopsEntered++;
+
     if (updateScreen)
         (*updateScreen)();
     screenRedrawScreen();
@@ -371,13 +442,26 @@ void EventHandler::run() {
     while (!ended && !controllerDone) {
         SDL_Event event;
 
+        /*
+         * play back keys typed ahead, unless still waiting; keys kept
+         * for a controller that is no longer on top, e.g. because a
+         * prompt has been pushed over it, are dropped
+         */
+        if (!typeAhead.empty() && !dynamic_cast<WaitController *>(getController())) {
+            TypedKey typed = typeAhead.front();
+            typeAhead.pop_front();
+            if (typed.controller == getController())
+                handleKey(typed.key, typed.controller, updateScreen);
+            continue;
+        }
+
         SDL_WaitEvent(&event);
 
         switch (event.type) {
         default:
             break;
         case SDL_KEYDOWN:
-            handleKeyDownEvent(event, getController(), updateScreen);
+            handleKey(translateKeyDownEvent(event), getController(), updateScreen);
             break;
 
         case SDL_MOUSEBUTTONDOWN:
@@ -41,6 +41,7 @@
 #include "person.h"
 #include "player.h"
 #include "portal.h"
+#include "profiler.h"
 #include "progress_bar.h"
 #include "savegame.h"
 #include "screen.h"
@@ -199,6 +200,7 @@ void GameController::initScreenWithoutReloadingState()
     musicMgr->play();
     imageMgr->get(BKGD_BORDERS)->image->draw(0, 0);
     c->stats->update(); /* draw the party stats */
+    screenRedrawMessageArea();
 
     screenMessage("Press Alt-h for help\n");
     screenPrompt();
@@ -216,6 +218,9 @@ void GameController::init() {
 
     initScreen();
 
+    /* the gem view tiles are only needed later, so decode them in the background */
+    imageMgr->preload(vector<string>(1, BKGD_GEMTILES));
+
     ProgressBar pb((320/2) - (200/2), (200/2), 200, 10, 0, 4);
     pb.setBorderColor(240, 240, 240);
     pb.setBorderWidth(1);
@@ -232,6 +237,7 @@ void GameController::init() {
     /* initialize conversation and game state variables */    
     c->line = TEXT_AREA_H - 1;
     c->col = 0;
+    screenClearMessageArea();
     c->stats = new StatsArea();
     c->moonPhase = 0;
     c->windDirection = DIR_NORTH;
@@ -619,6 +625,7 @@ int GameController::exitToParentMap() {
  * moves, etc.
  */
 void GameController::finishTurn() {
+    PROFILE_ZONE("GameController::finishTurn()");
     c->lastCommandTime = time(NULL);
     Creature *attacker = NULL;    
 
@@ -2455,7 +2462,7 @@ bool openAt(const Coords &coords) {
     
     Tile *floor = c->location->map->tileset->getByName("brick_floor");
     ASSERT(floor, "no floor tile found in tileset");
-    c->location->map->annotations->add(coords, floor->getId(), false, true)->setTTL(4);
+    c->location->map->annotations->add(coords, floor->getId(), false, true, 4);
 
     screenMessage("\nOpened!\n");
 
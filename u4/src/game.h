@@ -95,6 +95,7 @@ public:
     /* controller functions */
     virtual bool keyPressed(int key);
     virtual void timerFired();
+    bool isKeyBufferable(int key) const { return key != U4_ESC; }
 
     /* main game functions */
     void init();
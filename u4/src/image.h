@@ -60,7 +60,9 @@ public:
 
     static Image *create(int w, int h, bool indexed, Type type);
     static Image *createScreenImage();
-    static Image *duplicate(Image *image);
+    static Image *duplicate(Image *image, Type type = HARDWARE);
+    static Image *duplicateForScreen(Image *image);
+    static Image *convert(Image *image, Type type);
     ~Image();
 
     /* palette handling */
@@ -146,6 +148,24 @@ public:
     int width() const { return w; }
     int height() const { return h; }
     bool isIndexed() const { return indexed; }
+
+    /* direct access to the pixel rows, for bulk operations; see ImageLock */
+    void lock();
+    void unlock();
+    int bytesPerPixel() const;
+    uint8_t *getRow8(int y) const;
+    uint32_t *getRow32(int y) const;
+
+    /* bulk access to a span of n pixels along a row */
+    void getSpan(int x, int y, int n, unsigned int *indexes) const;
+    void putSpan(int x, int y, int n, const unsigned int *indexes);
+    void putSpan(int x, int y, int n, const uint8_t *indexes);
+    void fillSpan(int x, int y, int n, unsigned int index);
+    void getSpanRGBA(int x, int y, int n, uint8_t *rgba) const;
+    void putSpanRGBA(int x, int y, int n, const uint8_t *rgba);
+    void putSpanRGB(int x, int y, int n, const uint8_t *rgb);
+    void remapIndexes(const unsigned int *map, unsigned int n_entries);
+
     BackendSurface getSurface() { return surface; }
     void save(const string &filename);
 #ifdef IOS
@@ -174,4 +194,20 @@ private:
     BackendSurface surface;
 };
 
+/**
+ * Locks an image for direct access to its pixels for as long as the
+ * lock is in scope.  Surfaces that don't need locking are left alone.
+ */
+class ImageLock {
+public:
+    ImageLock(Image *im) : image(im) { image->lock(); }
+    ~ImageLock() { image->unlock(); }
+
+private:
+    ImageLock(const ImageLock&);
+    const ImageLock &operator=(const ImageLock&);
+
+    Image *image;
+};
+
 #endif /* IMAGE_H */
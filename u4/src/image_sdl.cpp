@@ -7,16 +7,108 @@
 #include <SDL.h>
 
 #include <memory>
-#include <list>
 #include <utility>
+#include <vector>
 #include "debug.h"
 #include "image.h"
+#include "screen.h"
 #include "settings.h"
 #include "error.h"
 
 Image::Image() : surface(NULL) {
 }
 
+/**
+ * Reports an area drawn on the screen surface to the screen's damage
+ * tracker, so that it is pushed to the display on the next redraw.
+ */
+static void imageDamage(const SDL_Surface *dest, const SDL_Rect &r) {
+    if (dest == SDL_GetVideoSurface()) {
+        screenDamage(r.x, r.y, r.w, r.h);
+        screenMapAreaDrawn(r.x, r.y, r.w, r.h);
+    }
+}
+
+/*
+ * The channel masks of 32-bit images, which put the red, green, blue
+ * and alpha bytes in that order in memory.
+ */
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+#define IMAGE_RMASK 0xff000000
+#define IMAGE_GMASK 0x00ff0000
+#define IMAGE_BMASK 0x0000ff00
+#define IMAGE_AMASK 0x000000ff
+#else
+#define IMAGE_RMASK 0x000000ff
+#define IMAGE_GMASK 0x0000ff00
+#define IMAGE_BMASK 0x00ff0000
+#define IMAGE_AMASK 0xff000000
+#endif
+
+/**
+ * Returns true if pixels in the given format are stored as red, green,
+ * blue and alpha bytes, so that they can be copied to and from RGBA
+ * byte spans directly.
+ */
+static bool imageIsByteRGBA(const SDL_PixelFormat *format) {
+    return format->BytesPerPixel == 4 &&
+        format->Rmask == IMAGE_RMASK && format->Gmask == IMAGE_GMASK &&
+        format->Bmask == IMAGE_BMASK && format->Amask == IMAGE_AMASK;
+}
+
+/**
+ * Reads the packed value of the pixel at p, which is bpp bytes wide.
+ */
+static inline Uint32 imageLoadPixel(const Uint8 *p, int bpp) {
+    switch(bpp) {
+    case 1:
+        return *p;
+
+    case 2:
+        return *reinterpret_cast<const Uint16 *>(p);
+
+    case 3:
+        if(SDL_BYTEORDER == SDL_BIG_ENDIAN)
+            return p[0] << 16 | p[1] << 8 | p[2];
+        else
+            return p[0] | p[1] << 8 | p[2] << 16;
+
+    default:
+        return *reinterpret_cast<const Uint32 *>(p);
+    }
+}
+
+/**
+ * Writes the packed value of the pixel at p, which is bpp bytes wide.
+ */
+static inline void imageStorePixel(Uint8 *p, int bpp, Uint32 index) {
+    switch(bpp) {
+    case 1:
+        *p = index;
+        break;
+
+    case 2:
+        *reinterpret_cast<Uint16 *>(p) = index;
+        break;
+
+    case 3:
+        if(SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+            p[0] = (index >> 16) & 0xff;
+            p[1] = (index >> 8) & 0xff;
+            p[2] = index & 0xff;
+        } else {
+            p[0] = index & 0xff;
+            p[1] = (index >> 8) & 0xff;
+            p[2] = (index >> 16) & 0xff;
+        }
+        break;
+
+    default:
+        *reinterpret_cast<Uint32 *>(p) = index;
+        break;
+    }
+}
+
 /**
  * Creates a new image.  Scale is stored to allow drawing using U4
  * (320x200) coordinates, regardless of the actual image scale.
@@ -25,7 +117,6 @@ Image::Image() : surface(NULL) {
  * or software (i.e. normal ram) image.
  */
 Image *Image::create(int w, int h, bool indexed, Image::Type type) {
-    Uint32 rmask, gmask, bmask, amask;
     Uint32 flags;
     Image *im = new Image;
 
@@ -33,27 +124,15 @@ Image *Image::create(int w, int h, bool indexed, Image::Type type) {
     im->h = h;
     im->indexed = indexed;
 
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-    rmask = 0xff000000;
-    gmask = 0x00ff0000;
-    bmask = 0x0000ff00;
-    amask = 0x000000ff;
-#else
-    rmask = 0x000000ff;
-    gmask = 0x0000ff00;
-    bmask = 0x00ff0000;
-    amask = 0xff000000;
-#endif
-
     if (type == Image::HARDWARE)
         flags = SDL_HWSURFACE | SDL_SRCALPHA;
     else
         flags = SDL_SWSURFACE | SDL_SRCALPHA;
 
     if (indexed)
-        im->surface = SDL_CreateRGBSurface(flags, w, h, 8, rmask, gmask, bmask, amask);
+        im->surface = SDL_CreateRGBSurface(flags, w, h, 8, IMAGE_RMASK, IMAGE_GMASK, IMAGE_BMASK, IMAGE_AMASK);
     else
-        im->surface = SDL_CreateRGBSurface(flags, w, h, 32, rmask, gmask, bmask, amask);
+        im->surface = SDL_CreateRGBSurface(flags, w, h, 32, IMAGE_RMASK, IMAGE_GMASK, IMAGE_BMASK, IMAGE_AMASK);
 
     if (!im->surface) {
         delete im;
@@ -81,9 +160,9 @@ Image *Image::createScreenImage() {
 /**
  * Creates a duplicate of another image
  */
-Image *Image::duplicate(Image *image) {    
+Image *Image::duplicate(Image *image, Image::Type type) {    
     bool alphaOn = image->isAlphaOn();
-    Image *im = create(image->width(), image->height(), false, HARDWARE);
+    Image *im = create(image->width(), image->height(), false, type);
     
 //    if (image->isIndexed())
 //        im->setPaletteFromImage(image);
@@ -102,6 +181,63 @@ Image *Image::duplicate(Image *image) {
     return im;
 }
 
+/**
+ * Creates an exact copy of another image, in the same pixel format
+ * and with the same palette and transparency, as the given type of
+ * image.  Images loaded as software images off the main thread are
+ * turned into hardware images this way.
+ */
+Image *Image::convert(Image *image, Image::Type type) {
+    Uint32 flags = (type == HARDWARE ? SDL_HWSURFACE : SDL_SWSURFACE) | SDL_SRCALPHA;
+    SDL_Surface *surface = SDL_ConvertSurface(image->surface, image->surface->format, flags);
+    if (!surface)
+        return NULL;
+
+    /* SDL drops the color key when the format has an alpha mask, as ours always do */
+    if (image->surface->flags & SDL_SRCCOLORKEY)
+        SDL_SetColorKey(surface, SDL_SRCCOLORKEY, image->surface->format->colorkey);
+
+    Image *im = new Image;
+    im->w = image->w;
+    im->h = image->h;
+    im->indexed = image->indexed;
+    im->surface = surface;
+    im->backgroundColor = image->backgroundColor;
+
+    return im;
+}
+
+/**
+ * Creates a duplicate of another image in the pixel format of the
+ * screen, so drawing it to the screen needs no conversion.  Falls back
+ * to a plain duplicate if there is no screen yet.
+ */
+Image *Image::duplicateForScreen(Image *image) {
+    if (SDL_GetVideoSurface() == NULL)
+        return duplicate(image);
+
+    bool alphaOn = image->isAlphaOn();
+    if (alphaOn)
+        image->alphaOff();
+
+    SDL_Surface *surface = SDL_DisplayFormat(image->surface);
+
+    if (alphaOn)
+        image->alphaOn();
+
+    if (!surface)
+        return duplicate(image);
+
+    Image *im = new Image;
+    im->w = surface->w;
+    im->h = surface->h;
+    im->indexed = surface->format->palette != NULL;
+    im->surface = surface;
+    im->backgroundColor = image->backgroundColor;
+
+    return im;
+}
+
 /**
  * Frees the image.
  */
@@ -299,13 +435,99 @@ void Image::makeBackgroundColorTransparent(int haloSize, int shadowOpacity)
 			static_cast<Uint8>(backgroundColor.b),
 			static_cast<Uint8>(backgroundColor.a));
 
+	ImageLock pixelLock(this);
 	performTransparencyHack(bgColor, 1, 0, haloSize,shadowOpacity);
 }
 
+/**
+ * Adds the shadow halo of the transparency hack to a frame of RGBA
+ * pixels.  Every pixel that isn't fully opaque gains, from each
+ * casting pixel no more than span pixels away along either axis,
+ * increment / (1 + 2 * span - dx - dy) of opacity.
+ *
+ * A two-pass chessboard distance transform first finds how far each
+ * pixel is from the nearest casting pixel, so only the pixels that
+ * can receive any halo gather from their neighbourhood.  The frame is
+ * worked on in isolation, so separate frames can be done at the same
+ * time.
+ */
+static void imageTransparencyHalo(uint8_t *pixels, const uint8_t *casts, int w, int h, int span, unsigned int increment) {
+    const int size = span * 2 + 1;
+    const int far = span + 1;
+    std::vector<int> dist(w * h);
+    std::vector<unsigned int> weights(size * size);
+    int x, y, i;
+
+    for (y = 0; y < size; y++) {
+        for (x = 0; x < size; x++)
+            weights[y * size + x] = increment / (1 + span * 2 - abs(x - span) - abs(y - span));
+    }
+
+    /* forward pass, from the neighbours above and to the left */
+    for (y = 0, i = 0; y < h; y++) {
+        for (x = 0; x < w; x++, i++) {
+            int d = casts[i] ? 0 : far;
+            if (x > 0)
+                d = std::min(d, dist[i - 1] + 1);
+            if (y > 0) {
+                d = std::min(d, dist[i - w] + 1);
+                if (x > 0)
+                    d = std::min(d, dist[i - w - 1] + 1);
+                if (x < w - 1)
+                    d = std::min(d, dist[i - w + 1] + 1);
+            }
+            dist[i] = std::min(d, far);
+        }
+    }
+
+    /* backward pass, from the neighbours below and to the right */
+    for (y = h - 1, i = w * h - 1; y >= 0; y--) {
+        for (x = w - 1; x >= 0; x--, i--) {
+            int d = dist[i];
+            if (x < w - 1)
+                d = std::min(d, dist[i + 1] + 1);
+            if (y < h - 1) {
+                d = std::min(d, dist[i + w] + 1);
+                if (x < w - 1)
+                    d = std::min(d, dist[i + w + 1] + 1);
+                if (x > 0)
+                    d = std::min(d, dist[i + w - 1] + 1);
+            }
+            dist[i] = d;
+        }
+    }
+
+    for (y = 0, i = 0; y < h; y++) {
+        for (x = 0; x < w; x++, i++) {
+            uint8_t *alpha = &pixels[i * 4 + 3];
+            if (*alpha == IM_OPAQUE || dist[i] > span)
+                continue;
+
+            int x_start = std::max(0, x - span), x_finish = std::min(w, x + span + 1);
+            int y_start = std::max(0, y - span), y_finish = std::min(h, y + span + 1);
+            unsigned int a = *alpha;
+
+            for (int cy = y_start; cy < y_finish && a < IM_OPAQUE; cy++) {
+                const uint8_t *castRow = casts + cy * w;
+                const unsigned int *weightRow = &weights[(cy - y + span) * size];
+                for (int cx = x_start; cx < x_finish; cx++) {
+                    if (castRow[cx])
+                        a += weightRow[cx - x + span];
+                }
+            }
+            *alpha = std::min(IM_OPAQUE, a);
+        }
+    }
+}
+
+/**
+ * The image must be locked first.  Each call only touches the rows of
+ * its own frame, so different frames can be worked on at the same
+ * time from different threads.
+ */
 //TODO Separate functionalities found in here
 void Image::performTransparencyHack(unsigned int colorValue, unsigned int numFrames, unsigned int currentFrameIndex, unsigned int haloWidth, unsigned int haloOpacityIncrementByPixelDistance)
 {
-    std::list<std::pair<unsigned int,unsigned int> > opaqueXYs;
     unsigned int x, y;
     Uint8 t_r, t_g, t_b;
 
@@ -316,51 +538,37 @@ void Image::performTransparencyHack(unsigned int colorValue, unsigned int numFra
     //Min'd so that they never go out of range (>=h)
     unsigned int top = std::min(h, currentFrameIndex * frameHeight);
     unsigned int bottom = std::min(h, top + frameHeight);
+    unsigned int rows = bottom - top;
 
-    for (y = top; y < bottom; y++) {
+    if (rows == 0 || w == 0)
+        return;
+
+    /* work on a copy of the frame as RGBA bytes, written back in one go at the end */
+    std::vector<uint8_t> pixels(w * rows * 4);
+    std::vector<uint8_t> casts(w * rows);
+
+    /* every pixel not of the transparent color casts a halo */
+    for (y = 0; y < rows; y++) {
+        uint8_t *row = &pixels[y * w * 4];
+        getSpanRGBA(0, top + y, w, row);
 
         for (x = 0; x < w; x++) {
-            unsigned int r, g, b, a;
-            getPixel(x, y, r, g, b, a);
-            if (r == t_r &&
-                g == t_g &&
-                b == t_b) {
-                putPixel(x, y, r, g, b, IM_TRANSPARENT);
+            uint8_t *p = row + x * 4;
+            if (p[0] == t_r &&
+                p[1] == t_g &&
+                p[2] == t_b) {
+                p[3] = IM_TRANSPARENT;
             } else {
-                putPixel(x, y, r, g, b, a);
-                if (haloWidth)
-                	opaqueXYs.push_back(std::pair<int,int>(x,y));
+                casts[y * w + x] = 1;
             }
         }
     }
-    int ox, oy;
-    for (std::list<std::pair<unsigned int,unsigned int> >::iterator xy = opaqueXYs.begin();
-    		xy != opaqueXYs.end();
-    		++xy)
-    {
-    	ox = xy->first;
-    	oy = xy->second;
-    	int span = int(haloWidth);
-    	unsigned int x_start = std::max(0,ox - span);
-    	unsigned int x_finish = std::min(int(w), ox + span + 1);
-    	for (x = x_start; x < x_finish; ++x)
-    	{
-    		unsigned int y_start = std::max(int(top),oy - span);
-    		unsigned int y_finish = std::min(int(bottom), oy + span + 1);
-        	for (y = y_start; y < y_finish; ++y) {
-
-        		int divisor = 1 + span * 2 - abs(ox - x) - abs(oy - y);
-
-                unsigned int r, g, b, a;
-                getPixel(x, y, r, g, b, a);
-                if (a != IM_OPAQUE) {
-                    putPixel(x, y, r, g, b, std::min(IM_OPAQUE, a + haloOpacityIncrementByPixelDistance / divisor));
-                }
-        	}
-    	}
-    }
 
+    if (haloWidth)
+        imageTransparencyHalo(&pixels[0], &casts[0], w, rows, haloWidth, haloOpacityIncrementByPixelDistance);
 
+    for (y = 0; y < rows; y++)
+        putSpanRGBA(0, top + y, w, &pixels[y * w * 4]);
 }
 
 void Image::setTransparentIndex(unsigned int index)//, unsigned int numFrames, unsigned int currentFrameIndex, int shadowOutlineWidth, int shadowOpacityOverride)
@@ -378,37 +586,9 @@ void Image::setTransparentIndex(unsigned int index)//, unsigned int numFrames, u
  * If the image is RGB, it is a packed RGB triplet.
  */
 void Image::putPixelIndex(int x, int y, unsigned int index) {
-    int bpp;
-    Uint8 *p;
-
-    bpp = surface->format->BytesPerPixel;
-    p = static_cast<Uint8 *>(surface->pixels) + y * surface->pitch + x * bpp;
-
-    switch(bpp) {
-    case 1:
-        *p = index;
-        break;
-
-    case 2:
-        *reinterpret_cast<Uint16 *>(p) = index;
-        break;
-
-    case 3:
-        if(SDL_BYTEORDER == SDL_BIG_ENDIAN) {
-            p[0] = (index >> 16) & 0xff;
-            p[1] = (index >> 8) & 0xff;
-            p[2] = index & 0xff;
-        } else {
-            p[0] = index & 0xff;
-            p[1] = (index >> 8) & 0xff;
-            p[2] = (index >> 16) & 0xff;
-        }
-        break;
+    int bpp = surface->format->BytesPerPixel;
 
-    case 4:
-        *reinterpret_cast<Uint32 *>(p) = index;
-        break;
-    }
+    imageStorePixel(getRow8(y) + x * bpp, bpp, index);
 }
 
 /**
@@ -425,6 +605,7 @@ void Image::fillRect(int x, int y, int w, int h, int r, int g, int b, int a) {
     dest.h = h;
 
     SDL_FillRect(surface, &dest, pixel);
+    imageDamage(surface, dest);
 }
 
 /**
@@ -451,30 +632,224 @@ void Image::getPixel(int x, int y, unsigned int &r, unsigned int &g, unsigned in
 void Image::getPixelIndex(int x, int y, unsigned int &index) const {
     int bpp = surface->format->BytesPerPixel;
 
-    Uint8 *p = static_cast<Uint8 *>(surface->pixels) + y * surface->pitch + x * bpp;
+    index = imageLoadPixel(getRow8(y) + x * bpp, bpp);
+}
 
-    switch(bpp) {
+/**
+ * Locks the image so that its pixels can be accessed directly.  Every
+ * lock must be matched by an unlock; ImageLock does both.
+ */
+void Image::lock() {
+    if (SDL_MUSTLOCK(surface))
+        SDL_LockSurface(surface);
+}
+
+void Image::unlock() {
+    if (SDL_MUSTLOCK(surface))
+        SDL_UnlockSurface(surface);
+}
+
+/**
+ * Returns the number of bytes used to store each pixel.
+ */
+int Image::bytesPerPixel() const {
+    return surface->format->BytesPerPixel;
+}
+
+/**
+ * Returns a pointer to the first pixel of row y.  Rows are not
+ * necessarily contiguous; successive rows are a pitch apart.
+ */
+uint8_t *Image::getRow8(int y) const {
+    return static_cast<uint8_t *>(surface->pixels) + y * surface->pitch;
+}
+
+/**
+ * Returns a pointer to the first pixel of row y of a 32-bit image.
+ */
+uint32_t *Image::getRow32(int y) const {
+    ASSERT(surface->format->BytesPerPixel == 4, "getRow32 called on a %d-bit image", surface->format->BitsPerPixel);
+    return reinterpret_cast<uint32_t *>(getRow8(y));
+}
+
+/**
+ * Reads the packed values of n pixels starting at x, y: palette
+ * indexes for indexed images, packed RGBA for the rest.
+ */
+void Image::getSpan(int x, int y, int n, unsigned int *indexes) const {
+    int bpp = surface->format->BytesPerPixel;
+    const Uint8 *p = getRow8(y) + x * bpp;
+    int i;
+
+    switch (bpp) {
     case 1:
-        index = *p;
+        for (i = 0; i < n; i++)
+            indexes[i] = p[i];
         break;
 
-    case 2:
-        index = *reinterpret_cast<Uint16 *>(p);
+    case 4:
+        for (i = 0; i < n; i++)
+            indexes[i] = reinterpret_cast<const Uint32 *>(p)[i];
         break;
 
-    case 3:
-        if(SDL_BYTEORDER == SDL_BIG_ENDIAN)
-            index = p[0] << 16 | p[1] << 8 | p[2];
-        else
-            index = p[0] | p[1] << 8 | p[2] << 16;
+    default:
+        for (i = 0; i < n; i++)
+            indexes[i] = imageLoadPixel(p + i * bpp, bpp);
+        break;
+    }
+}
+
+/**
+ * Sets n pixels starting at x, y to the given packed values.
+ */
+void Image::putSpan(int x, int y, int n, const unsigned int *indexes) {
+    int bpp = surface->format->BytesPerPixel;
+    Uint8 *p = getRow8(y) + x * bpp;
+    int i;
+
+    switch (bpp) {
+    case 1:
+        for (i = 0; i < n; i++)
+            p[i] = indexes[i];
         break;
 
     case 4:
-        index = *reinterpret_cast<Uint32 *>(p);
+        for (i = 0; i < n; i++)
+            reinterpret_cast<Uint32 *>(p)[i] = indexes[i];
+        break;
 
     default:
+        for (i = 0; i < n; i++)
+            imageStorePixel(p + i * bpp, bpp, indexes[i]);
+        break;
+    }
+}
+
+/**
+ * Sets n pixels starting at x, y to the given byte-sized palette
+ * indexes, as decoded by the image loaders.
+ */
+void Image::putSpan(int x, int y, int n, const uint8_t *indexes) {
+    int bpp = surface->format->BytesPerPixel;
+    Uint8 *p = getRow8(y) + x * bpp;
+
+    if (bpp == 1)
+        memcpy(p, indexes, n);
+    else {
+        for (int i = 0; i < n; i++)
+            imageStorePixel(p + i * bpp, bpp, indexes[i]);
+    }
+}
+
+/**
+ * Sets n pixels starting at x, y to a single packed value.
+ */
+void Image::fillSpan(int x, int y, int n, unsigned int index) {
+    int bpp = surface->format->BytesPerPixel;
+    Uint8 *p = getRow8(y) + x * bpp;
+    int i;
+
+    switch (bpp) {
+    case 1:
+        memset(p, index, n);
+        break;
+
+    case 4:
+        for (i = 0; i < n; i++)
+            reinterpret_cast<Uint32 *>(p)[i] = index;
+        break;
+
+    default:
+        for (i = 0; i < n; i++)
+            imageStorePixel(p + i * bpp, bpp, index);
+        break;
+    }
+}
+
+/**
+ * Reads the colors of n pixels starting at x, y as red, green, blue
+ * and alpha bytes.
+ */
+void Image::getSpanRGBA(int x, int y, int n, uint8_t *rgba) const {
+    const SDL_PixelFormat *format = surface->format;
+    int bpp = format->BytesPerPixel;
+    const Uint8 *p = getRow8(y) + x * bpp;
+
+    if (imageIsByteRGBA(format)) {
+        memcpy(rgba, p, n * 4);
         return;
     }
+
+    for (int i = 0; i < n; i++, p += bpp, rgba += 4)
+        SDL_GetRGBA(imageLoadPixel(p, bpp), format, &rgba[0], &rgba[1], &rgba[2], &rgba[3]);
+}
+
+/**
+ * Sets the colors of n pixels starting at x, y from red, green, blue
+ * and alpha bytes.
+ */
+void Image::putSpanRGBA(int x, int y, int n, const uint8_t *rgba) {
+    const SDL_PixelFormat *format = surface->format;
+    int bpp = format->BytesPerPixel;
+    Uint8 *p = getRow8(y) + x * bpp;
+
+    if (imageIsByteRGBA(format)) {
+        memcpy(p, rgba, n * 4);
+        return;
+    }
+
+    for (int i = 0; i < n; i++, p += bpp, rgba += 4)
+        imageStorePixel(p, bpp, SDL_MapRGBA(format, rgba[0], rgba[1], rgba[2], rgba[3]));
+}
+
+/**
+ * Sets the colors of n pixels starting at x, y from red, green and
+ * blue bytes, making them opaque.
+ */
+void Image::putSpanRGB(int x, int y, int n, const uint8_t *rgb) {
+    const SDL_PixelFormat *format = surface->format;
+    int bpp = format->BytesPerPixel;
+    Uint8 *p = getRow8(y) + x * bpp;
+    int i;
+
+    if (imageIsByteRGBA(format)) {
+        for (i = 0; i < n; i++, p += 4, rgb += 3) {
+            p[0] = rgb[0];
+            p[1] = rgb[1];
+            p[2] = rgb[2];
+            p[3] = IM_OPAQUE;
+        }
+        return;
+    }
+
+    for (i = 0; i < n; i++, p += bpp, rgb += 3)
+        imageStorePixel(p, bpp, SDL_MapRGBA(format, rgb[0], rgb[1], rgb[2], IM_OPAQUE));
+}
+
+/**
+ * Replaces every pixel value below n_entries with its entry in map,
+ * leaving the other pixels alone.  Meant for indexed images, where it
+ * remaps the whole image from one palette order to another.
+ */
+void Image::remapIndexes(const unsigned int *map, unsigned int n_entries) {
+    int bpp = surface->format->BytesPerPixel;
+
+    for (unsigned int y = 0; y < h; y++) {
+        Uint8 *p = getRow8(y);
+
+        if (bpp == 1) {
+            for (unsigned int x = 0; x < w; x++) {
+                if (p[x] < n_entries)
+                    p[x] = map[p[x]];
+            }
+        } else {
+            for (unsigned int x = 0; x < w; x++, p += bpp) {
+                Uint32 index = imageLoadPixel(p, bpp);
+                if (index < n_entries)
+                    imageStorePixel(p, bpp, map[index]);
+            }
+        }
+    }
 }
 
 /**
@@ -493,7 +868,8 @@ void Image::drawOn(Image *d, int x, int y) const {
     r.y = y;
     r.w = w;
     r.h = h;
-    SDL_BlitSurface(surface, NULL, destSurface, &r);
+    if (SDL_BlitSurface(surface, NULL, destSurface, &r) == 0)
+        imageDamage(destSurface, r);
 }
 
 /**
@@ -518,7 +894,8 @@ void Image::drawSubRectOn(Image *d, int x, int y, int rx, int ry, int rw, int rh
     /* dest w & h unused */
 
 
-    SDL_BlitSurface(surface, &src, destSurface, &dest);
+    if (SDL_BlitSurface(surface, &src, destSurface, &dest) == 0)
+        imageDamage(destSurface, dest);
 }
 
 /**
@@ -546,6 +923,12 @@ void Image::drawSubRectInvertedOn(Image *d, int x, int y, int rx, int ry, int rw
 
         SDL_BlitSurface(surface, &src, destSurface, &dest);
     }
+
+    dest.x = x;
+    dest.y = y;
+    dest.w = rw;
+    dest.h = rh;
+    imageDamage(destSurface, dest);
 }
 
 /**
@@ -558,11 +941,19 @@ void Image::save(const string &filename) {
 
 
 void Image::drawHighlighted() {
-    RGBA c;
+    std::vector<uint8_t> row(w * 4);
+    ImageLock pixelLock(this);
+
+    if (w == 0)
+        return;
+
     for (unsigned i = 0; i < h; i++) {
-        for (unsigned j = 0; j < w; j++) {
-            getPixel(j, i, c.r, c.g, c.b, c.a);
-            putPixel(j, i, 0xff - c.r, 0xff - c.g, 0xff - c.b, c.a);
+        getSpanRGBA(0, i, w, &row[0]);
+        for (unsigned j = 0; j < w * 4; j += 4) {
+            row[j] = 0xff - row[j];
+            row[j + 1] = 0xff - row[j + 1];
+            row[j + 2] = 0xff - row[j + 2];
         }
+        putSpanRGBA(0, i, w, &row[0]);
     }
 }
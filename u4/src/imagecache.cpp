@@ -0,0 +1,254 @@
+/*
+ * $Id$
+ */
+
+#include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "imagecache.h"
+
+#include "filesystem.h"
+#include "image.h"
+
+using std::string;
+
+/*
+ * An entry is this header, then the key, then the palette of an
+ * indexed image as RGB triplets, then the pixel rows exactly as the
+ * image holds them.  The header is in the machine's own byte order, so
+ * an entry from a machine of the other order fails the magic check.
+ */
+#define IMAGECACHE_MAGIC 0x43345558     /* "XU4C" */
+#define IMAGECACHE_VERSION 1            /* bump when the loaders, fixups or scalers change their output */
+#define IMAGECACHE_PALETTE_SIZE 256
+
+#define IMAGECACHE_INDEXED      0x01
+#define IMAGECACHE_TRANSPARENT  0x02
+#define IMAGECACHE_ALPHA        0x04
+
+struct ImageCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t keyLength;
+    uint32_t width, height;
+    uint32_t flags;
+    uint32_t transparentIndex;
+};
+
+/**
+ * A read-only view of a whole cache entry: mapped into memory where
+ * the platform allows it, read in otherwise.
+ */
+class ImageCacheFile {
+public:
+    ImageCacheFile(const string &path);
+    ~ImageCacheFile();
+
+    const uint8_t *data;
+    size_t size;
+
+private:
+    ImageCacheFile(const ImageCacheFile&);
+    const ImageCacheFile &operator=(const ImageCacheFile&);
+
+#if defined(_WIN32)
+    std::vector<uint8_t> buffer;
+#endif
+};
+
+#if defined(_WIN32)
+
+ImageCacheFile::ImageCacheFile(const string &path) : data(NULL), size(0) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return;
+
+    fseek(file, 0L, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+
+    if (length > 0) {
+        buffer.resize(length);
+        if (fread(&buffer[0], 1, length, file) == size_t(length)) {
+            data = &buffer[0];
+            size = length;
+        }
+    }
+    fclose(file);
+}
+
+ImageCacheFile::~ImageCacheFile() {
+}
+
+#else
+
+ImageCacheFile::ImageCacheFile(const string &path) : data(NULL), size(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data = static_cast<const uint8_t *>(p);
+            size = st.st_size;
+        }
+    }
+    close(fd);
+}
+
+ImageCacheFile::~ImageCacheFile() {
+    if (data)
+        munmap(const_cast<uint8_t *>(data), size);
+}
+
+#endif
+
+ImageCache::ImageCache(const string &dir) : dir(dir) {
+    FileSystem::createDirectory(dir);
+}
+
+/**
+ * Returns a new image holding the given entry, or NULL if there is no
+ * such entry or it was made from a different key.
+ */
+Image *ImageCache::load(const string &entry, const string &key, Image::Type type) const {
+    ImageCacheFile file(getPath(entry));
+    ImageCacheHeader header;
+
+    if (file.size < sizeof(header))
+        return NULL;
+    memcpy(&header, file.data, sizeof(header));
+    if (header.magic != IMAGECACHE_MAGIC || header.version != IMAGECACHE_VERSION || header.keyLength != key.size())
+        return NULL;
+
+    bool indexed = (header.flags & IMAGECACHE_INDEXED) != 0;
+    size_t rowSize = size_t(header.width) * (indexed ? 1 : 4);
+    size_t paletteSize = indexed ? IMAGECACHE_PALETTE_SIZE * 3 : 0;
+    if (file.size != sizeof(header) + key.size() + paletteSize + rowSize * header.height)
+        return NULL;
+
+    const uint8_t *p = file.data + sizeof(header);
+    if (memcmp(p, key.data(), key.size()) != 0)
+        return NULL;
+    p += key.size();
+
+    Image *image = Image::create(header.width, header.height, indexed, type);
+    if (!image)
+        return NULL;
+    if (size_t(image->bytesPerPixel()) * header.width != rowSize) {
+        delete image;
+        return NULL;
+    }
+
+    if (indexed) {
+        RGBA palette[IMAGECACHE_PALETTE_SIZE];
+        for (int i = 0; i < IMAGECACHE_PALETTE_SIZE; i++, p += 3)
+            palette[i] = RGBA(p[0], p[1], p[2], IM_OPAQUE);
+        image->setPalette(palette, IMAGECACHE_PALETTE_SIZE);
+    }
+
+    {
+        ImageLock lock(image);
+        for (unsigned int y = 0; y < header.height; y++, p += rowSize)
+            memcpy(image->getRow8(y), p, rowSize);
+    }
+
+    if (header.flags & IMAGECACHE_TRANSPARENT)
+        image->setTransparentIndex(header.transparentIndex);
+    if (!(header.flags & IMAGECACHE_ALPHA))
+        image->alphaOff();
+
+    return image;
+}
+
+/**
+ * Stores an image as the given entry, replacing whatever was there.
+ * Failures are silently ignored; the image just gets made again next
+ * time.
+ */
+void ImageCache::save(const string &entry, const string &key, Image *image) const {
+    ImageCacheHeader header;
+    unsigned int transparentIndex = 0;
+    bool indexed = image->isIndexed();
+    size_t rowSize = size_t(image->width()) * image->bytesPerPixel();
+
+    if (image->bytesPerPixel() != (indexed ? 1 : 4))
+        return;
+
+    header.magic = IMAGECACHE_MAGIC;
+    header.version = IMAGECACHE_VERSION;
+    header.keyLength = key.size();
+    header.width = image->width();
+    header.height = image->height();
+    header.flags = 0;
+    if (indexed)
+        header.flags |= IMAGECACHE_INDEXED;
+    if (image->getTransparentIndex(transparentIndex))
+        header.flags |= IMAGECACHE_TRANSPARENT;
+    if (image->isAlphaOn())
+        header.flags |= IMAGECACHE_ALPHA;
+    header.transparentIndex = transparentIndex;
+
+    /* write the entry aside and move it into place once it's complete,
+       so an interrupted write never leaves a broken entry behind */
+    string path = getPath(entry);
+    string temp = path + ".tmp";
+    FILE *file = fopen(temp.c_str(), "wb");
+    if (!file)
+        return;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(key.data(), 1, key.size(), file) == key.size();
+
+    if (ok && indexed) {
+        uint8_t palette[IMAGECACHE_PALETTE_SIZE * 3];
+        for (int i = 0; i < IMAGECACHE_PALETTE_SIZE; i++) {
+            RGBA color = image->getPaletteColor(i);
+            palette[i * 3] = color.r;
+            palette[i * 3 + 1] = color.g;
+            palette[i * 3 + 2] = color.b;
+        }
+        ok = fwrite(palette, sizeof(palette), 1, file) == 1;
+    }
+
+    if (ok) {
+        ImageLock lock(image);
+        for (int y = 0; ok && y < image->height(); y++)
+            ok = fwrite(image->getRow8(y), 1, rowSize, file) == rowSize;
+    }
+
+    ok = (fclose(file) == 0) && ok;
+
+    if (ok) {
+        remove(path.c_str());
+        ok = rename(temp.c_str(), path.c_str()) == 0;
+    }
+    if (!ok)
+        remove(temp.c_str());
+}
+
+/**
+ * Returns the file holding an entry.  Anything in the entry name that
+ * might not be safe in a file name is replaced.
+ */
+string ImageCache::getPath(const string &entry) const {
+    string filename = entry;
+    for (string::iterator i = filename.begin(); i != filename.end(); i++) {
+        if (!isalnum(static_cast<unsigned char>(*i)) && *i != '-' && *i != '.')
+            *i = '_';
+    }
+    return dir + filename + ".img";
+}
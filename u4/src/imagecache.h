@@ -0,0 +1,31 @@
+/*
+ * $Id$
+ */
+
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <string>
+
+#include "image.h"
+
+/**
+ * Keeps images that have already been decoded, fixed up and scaled
+ * on disk, so the next run can map them straight back in.  Each entry
+ * is stored along with the key describing everything it was made
+ * from, and is only used while that key still matches.
+ */
+class ImageCache {
+public:
+    ImageCache(const std::string &dir);
+
+    Image *load(const std::string &entry, const std::string &key, Image::Type type) const;
+    void save(const std::string &entry, const std::string &key, Image *image) const;
+
+private:
+    std::string getPath(const std::string &entry) const;
+
+    std::string dir;
+};
+
+#endif /* IMAGECACHE_H */
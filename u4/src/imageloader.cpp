@@ -4,6 +4,8 @@
 
 #include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
 
+#include <vector>
+
 #include "debug.h"
 #include "image.h"
 #include "imageloader.h"
@@ -39,58 +41,40 @@ ImageLoader *ImageLoader::registerLoader(ImageLoader *loader, const std::string
  */
 void ImageLoader::setFromRawData(Image *image, int width, int height, int bpp, unsigned char *rawData) {
     int x, y;
+    ImageLock lock(image);
 
     switch (bpp) {
 
     case 32:
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x++)
-                image->putPixel(x, y, 
-                                rawData[(y * width + x) * 4], 
-                                rawData[(y * width + x) * 4 + 1], 
-                                rawData[(y * width + x) * 4 + 2],
-                                rawData[(y * width + x) * 4 + 3]);
-        }
+        for (y = 0; y < height; y++)
+            image->putSpanRGBA(0, y, width, rawData + y * width * 4);
         break;
 
     case 24:
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x++)
-                image->putPixel(x, y, 
-                                rawData[(y * width + x) * 3], 
-                                rawData[(y * width + x) * 3 + 1], 
-                                rawData[(y * width + x) * 3 + 2],
-                                IM_OPAQUE);
-        }
+        for (y = 0; y < height; y++)
+            image->putSpanRGB(0, y, width, rawData + y * width * 3);
         break;
 
     case 8:
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x++)
-                image->putPixelIndex(x, y, rawData[y * width + x]);
-        }
+        for (y = 0; y < height; y++)
+            image->putSpan(0, y, width, rawData + y * width);
         break;
 
     case 4:
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x+=2) {
-                image->putPixelIndex(x, y, rawData[(y * width + x) / 2] >> 4);
-                image->putPixelIndex(x + 1, y, rawData[(y * width + x) / 2] & 0x0f);
-            }
-        }
-        break;
-
     case 1:
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x+=8) {
-                image->putPixelIndex(x + 0, y, (rawData[(y * width + x) / 8] >> 7) & 0x01);
-                image->putPixelIndex(x + 1, y, (rawData[(y * width + x) / 8] >> 6) & 0x01);
-                image->putPixelIndex(x + 2, y, (rawData[(y * width + x) / 8] >> 5) & 0x01);
-                image->putPixelIndex(x + 3, y, (rawData[(y * width + x) / 8] >> 4) & 0x01);
-                image->putPixelIndex(x + 4, y, (rawData[(y * width + x) / 8] >> 3) & 0x01);
-                image->putPixelIndex(x + 5, y, (rawData[(y * width + x) / 8] >> 2) & 0x01);
-                image->putPixelIndex(x + 6, y, (rawData[(y * width + x) / 8] >> 1) & 0x01);
-                image->putPixelIndex(x + 7, y, (rawData[(y * width + x) / 8] >> 0) & 0x01);
+        {
+            /* unpack each row into one byte per pixel, high bits first */
+            std::vector<uint8_t> row(width);
+            int perByte = 8 / bpp;
+            int mask = (1 << bpp) - 1;
+
+            for (y = 0; y < height; y++) {
+                for (x = 0; x < width; x++) {
+                    unsigned char byte = rawData[(y * width + x - x % perByte) / perByte];
+                    row[x] = (byte >> ((perByte - 1 - x % perByte) * bpp)) & mask;
+                }
+                if (width > 0)
+                    image->putSpan(0, y, width, &row[0]);
             }
         }
         break;
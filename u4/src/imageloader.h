@@ -8,7 +8,8 @@
 #include <map>
 #include <string>
 
-class Image;
+#include "image.h"
+
 class U4FILE;
 
 /**
@@ -23,7 +24,7 @@ class ImageLoader {
 public:
     ImageLoader() {}
     virtual ~ImageLoader() {}
-    virtual Image *load(U4FILE *file, int width, int height, int bpp) = 0;
+    virtual Image *load(U4FILE *file, int width, int height, int bpp, Image::Type type) = 0;
     static ImageLoader *getLoader(const std::string &fileType);
 
 protected:
@@ -14,7 +14,7 @@ class FMTOWNSImageLoader : public ImageLoader {
     static ImageLoader *instance_pic;
     static ImageLoader *instance_tif;
 public:
-    virtual Image *load(U4FILE *file, int width, int height, int bpp);
+    virtual Image *load(U4FILE *file, int width, int height, int bpp, Image::Type type);
     FMTOWNSImageLoader(int offset) : offset(offset){}
 protected:
     int offset;
@@ -30,7 +30,7 @@ static void png_read_xu4(png_structp png_ptr, png_bytep data, png_size_t length)
 /**
  * Loads in the PNG with the libpng library.
  */
-Image *PngImageLoader::load(U4FILE *file, int width, int height, int bpp) {
+Image *PngImageLoader::load(U4FILE *file, int width, int height, int bpp, Image::Type type) {
     if (width != -1 || height != -1 || bpp != -1) {
           errorWarning("dimensions set for PNG image, will be ignored");
     }
@@ -92,7 +92,7 @@ Image *PngImageLoader::load(U4FILE *file, int width, int height, int bpp) {
         }
     }
 
-    Image *image = Image::create(width, height, bpp == 4 || bpp == 8, Image::HARDWARE);
+    Image *image = Image::create(width, height, bpp == 4 || bpp == 8, type);
     if (!image) {
         delete [] raw;
         png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
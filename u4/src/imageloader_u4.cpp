@@ -29,7 +29,7 @@ RGBA *U4PaletteLoader::vgaPalette = NULL;
  * Loads in the raw image and apply the standard U4 16 or 256 color
  * palette.
  */
-Image *U4RawImageLoader::load(U4FILE *file, int width, int height, int bpp) {
+Image *U4RawImageLoader::load(U4FILE *file, int width, int height, int bpp, Image::Type type) {
     if (width == -1 || height == -1 || bpp == -1) {
           errorFatal("dimensions not set for u4raw image");
     }
@@ -48,7 +48,7 @@ Image *U4RawImageLoader::load(U4FILE *file, int width, int height, int bpp) {
         return NULL;
     }
 
-    Image *image = Image::create(width, height, bpp <= 8, Image::HARDWARE);
+    Image *image = Image::create(width, height, bpp <= 8, type);
     if (!image) {
         if (raw)
             free(raw);
@@ -74,7 +74,7 @@ Image *U4RawImageLoader::load(U4FILE *file, int width, int height, int bpp) {
  * Loads in the rle-compressed image and apply the standard U4 16 or
  * 256 color palette.
  */
-Image *U4RleImageLoader::load(U4FILE *file, int width, int height, int bpp) {
+Image *U4RleImageLoader::load(U4FILE *file, int width, int height, int bpp, Image::Type type) {
     if (width == -1 || height == -1 || bpp == -1) {
           errorFatal("dimensions not set for u4rle image");
     }
@@ -95,7 +95,7 @@ Image *U4RleImageLoader::load(U4FILE *file, int width, int height, int bpp) {
         return NULL;
     }
 
-    Image *image = Image::create(width, height, bpp <= 8, Image::HARDWARE);
+    Image *image = Image::create(width, height, bpp <= 8, type);
     if (!image) {
         if (raw)
             free(raw);
@@ -121,7 +121,7 @@ Image *U4RleImageLoader::load(U4FILE *file, int width, int height, int bpp) {
  * Loads in the lzw-compressed image and apply the standard U4 16 or
  * 256 color palette.
  */
-Image *U4LzwImageLoader::load(U4FILE *file, int width, int height, int bpp) {
+Image *U4LzwImageLoader::load(U4FILE *file, int width, int height, int bpp, Image::Type type) {
     if (width == -1 || height == -1 || bpp == -1) {
           errorFatal("dimensions not set for u4lzw image");
     }
@@ -142,7 +142,7 @@ Image *U4LzwImageLoader::load(U4FILE *file, int width, int height, int bpp) {
         return NULL;
     }
 
-    Image *image = Image::create(width, height, bpp <= 8, Image::HARDWARE);
+    Image *image = Image::create(width, height, bpp <= 8, type);
     if (!image) {
         if (raw)
             free(raw);
@@ -19,7 +19,7 @@ class U4RawImageLoader : public ImageLoader {
     static ImageLoader *instance;
 
 public:
-    virtual Image *load(U4FILE *file, int width, int height, int bpp);
+    virtual Image *load(U4FILE *file, int width, int height, int bpp, Image::Type type);
 
 };
 
@@ -33,7 +33,7 @@ class U4RleImageLoader : public ImageLoader {
     static ImageLoader *instance;
 
 public:
-    virtual Image *load(U4FILE *file, int width, int height, int bpp);
+    virtual Image *load(U4FILE *file, int width, int height, int bpp, Image::Type type);
     
 };
 
@@ -47,7 +47,7 @@ class U4LzwImageLoader : public ImageLoader {
     static ImageLoader *instance;
 
 public:
-    virtual Image *load(U4FILE *file, int width, int height, int bpp);
+    virtual Image *load(U4FILE *file, int width, int height, int bpp, Image::Type type);
     
 };
 
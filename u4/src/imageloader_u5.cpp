@@ -23,7 +23,7 @@ ImageLoader *U5LzwImageLoader::instance = ImageLoader::registerLoader(new U5LzwI
  * Loads in the lzw-compressed image and apply the standard U4 16 or
  * 256 color palette.
  */
-Image *U5LzwImageLoader::load(U4FILE *file, int width, int height, int bpp) {
+Image *U5LzwImageLoader::load(U4FILE *file, int width, int height, int bpp, Image::Type type) {
     if (width == -1 || height == -1 || bpp == -1) {
           errorFatal("dimensions not set for u5lzw image");
     }
@@ -46,7 +46,7 @@ Image *U5LzwImageLoader::load(U4FILE *file, int width, int height, int bpp) {
         return NULL;
     }
 
-    Image *image = Image::create(width, height, bpp == 4 || bpp == 8, Image::HARDWARE);
+    Image *image = Image::create(width, height, bpp == 4 || bpp == 8, type);
     if (!image) {
         if (raw)
             delete [] raw;
@@ -16,7 +16,7 @@ class U5LzwImageLoader : public ImageLoader {
     static ImageLoader *instance;
 
 public:
-    virtual Image *load(U4FILE *file, int width, int height, int bpp);
+    virtual Image *load(U4FILE *file, int width, int height, int bpp, Image::Type type);
     
 };
 
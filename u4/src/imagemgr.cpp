@@ -4,23 +4,32 @@
 
 #include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 
 #include "config.h"
 #include "debug.h"
 #include "error.h"
 #include "image.h"
+#include "imagecache.h"
 #include "imageloader.h"
+#include "imageloader_u4.h"
 #include "imagemgr.h"
 #include "intro.h"
+#include "profiler.h"
+#include "scale.h"
 #include "settings.h"
 #include "u4file.h"
+#include "utils.h"
+#include "workqueue.h"
 
 using std::map;
 using std::string;
 using std::vector;
 
-Image *screenScale(Image *src, int scale, int n, int filter);
+Image *screenScaleWith(Image *src, int scale, int n, int filter, Scaler scaler, bool filter3x, Image::Type type);
 
 bool ImageInfo::hasBlackBackground()
 {
@@ -38,6 +47,53 @@ public:
     map<string, ImageInfo *> info;
 };
 
+/**
+ * Loads, fixes up and scales an image in the background.  The result is
+ * only handed over to the image's ImageInfo once the main thread asks
+ * for it.  SDL's video functions may only be used from the main thread,
+ * so the job builds a software image, which the main thread turns into
+ * a hardware image when it collects it, and uses the scaler it was
+ * given rather than the screen's.
+ */
+class ImageLoadJob : public Job {
+public:
+    ImageLoadJob(ImageInfo *info, ImageLoader *loader, U4FILE *file, Scaler scaler, bool filter3x) :
+        info(info), loader(loader), file(file), scaler(scaler), filter3x(filter3x), image(NULL), width(-1), height(-1) {}
+
+    virtual void run() {
+        image = imageMgr->load(info, loader, file, false, Image::SOFTWARE, scaler, filter3x, width, height);
+    }
+
+    ImageInfo *info;
+    ImageLoader *loader;
+    U4FILE *file;
+    Scaler scaler;
+    bool filter3x;
+    Image *image;
+    int width, height;
+};
+
+/**
+ * Applies the transparency hack to a run of frames of an image, which
+ * must be locked.
+ */
+class TransparencyHackJob : public Job {
+public:
+    TransparencyHackJob(Image *im, int frames, int first, int last) :
+        im(im), frames(frames), first(first), last(last) {}
+
+    virtual void run() {
+        int shadowSize = settings.enhancementsOptions.u4TrileTransparencyHackShadowBreadth;
+        int opacity = settings.enhancementsOptions.u4TileTransparencyHackPixelShadowOpacity;
+
+        for (int f = first; f < last; f++)
+            im->performTransparencyHack(0, frames, f, shadowSize, opacity);
+    }
+
+    Image *im;
+    int frames, first, last;
+};
+
 ImageMgr *ImageMgr::instance = NULL;
 
 ImageMgr *ImageMgr::getInstance() {
@@ -59,15 +115,21 @@ ImageMgr::ImageMgr() {
     logger = new Debug("debug/imagemgr.txt", "ImageMgr");
     TRACE(*logger, "creating ImageMgr");
 
+    cache = new ImageCache(settings.getUserPath() + "cache/");
+
     settings.addObserver(this);
 }
 
 ImageMgr::~ImageMgr() {
     settings.deleteObserver(this);
 
+    while (!preloadOrder.empty())
+        collectPreload(preloadOrder.front(), true);
+
     for (std::map<string, ImageSet *>::iterator i = imageSets.begin(); i != imageSets.end(); i++)
         delete i->second;
 
+    delete cache;
     delete logger;
 }
 
@@ -402,32 +464,29 @@ void ImageMgr::fixupIntro(Image *im, int prescale) {
 }
 
 void ImageMgr::fixupAbyssVision(Image *im, int prescale) {
-    static unsigned int *data = NULL;
+    static uint8_t *data = NULL;
+    int rowBytes = im->width() * im->bytesPerPixel();
+    ImageLock lock(im);
 
     /*
      * Each VGA vision components must be XORed with all the previous
-     * vision components to get the actual image.
+     * vision components to get the actual image.  XORing the packed
+     * pixel values is the same as XORing their bytes, so whole rows
+     * are done at a time.
      */
     if (data != NULL) {
         for (int y = 0; y < im->height(); y++) {
-            for (int x = 0; x < im->width(); x++) {
-                unsigned int index;
-                im->getPixelIndex(x, y, index);
-                index ^= data[y * im->width() + x];
-                im->putPixelIndex(x, y, index);
-            }
+            uint8_t *row = im->getRow8(y);
+            const uint8_t *prev = data + y * rowBytes;
+            for (int i = 0; i < rowBytes; i++)
+                row[i] ^= prev[i];
         }
     } else {
-        data = new unsigned int[im->width() * im->height()];
+        data = new uint8_t[rowBytes * im->height()];
     }
 
-    for (int y = 0; y < im->height(); y++) {
-        for (int x = 0; x < im->width(); x++) {
-            unsigned int index;
-            im->getPixelIndex(x, y, index);
-            data[y * im->width() + x] = index;
-        }
-    }
+    for (int y = 0; y < im->height(); y++)
+        memcpy(data + y * rowBytes, im->getRow8(y), rowBytes);
 }
 
 void ImageMgr::fixupAbacus(Image *im, int prescale) {
@@ -453,16 +512,10 @@ void ImageMgr::fixupAbacus(Image *im, int prescale) {
  * south.
  */
 void ImageMgr::fixupDungNS(Image *im, int prescale) {
-    for (int y = 0; y < im->height(); y++) {
-        for (int x = 0; x < im->width(); x++) {
-            unsigned int index;
-            im->getPixelIndex(x, y, index);
-            if (index == 1)
-                im->putPixelIndex(x, y, 2);
-            else if (index == 2)
-                im->putPixelIndex(x, y, 1);
-        }
-    }
+    static const unsigned int swapBlueGreen[] = { 0, 2, 1 };
+    ImageLock lock(im);
+
+    im->remapIndexes(swapBlueGreen, sizeof(swapBlueGreen) / sizeof(swapBlueGreen[0]));
 }
 
 /**
@@ -470,13 +523,11 @@ void ImageMgr::fixupDungNS(Image *im, int prescale) {
  * south.
  */
 void ImageMgr::fixupFMTowns(Image *im, int prescale) {
-    for (int y = 20; y < im->height(); y++) {
-        for (int x = 0; x < im->width(); x++) {
-            unsigned int index;
-            im->getPixelIndex(x, y, index);
-			im->putPixelIndex(x, y-20, index);
-        }
-    }
+    int rowBytes = im->width() * im->bytesPerPixel();
+    ImageLock lock(im);
+
+    for (int y = 20; y < im->height(); y++)
+        memcpy(im->getRow8(y - 20), im->getRow8(y), rowBytes);
 }
 
 /**
@@ -584,48 +635,189 @@ ImageInfo *ImageMgr::get(const string &name, bool returnUnscaled) {
     if (!info)
         return NULL;
 
+    /* take over the image if it was being loaded in the background */
+    if (preloads.find(info) != preloads.end())
+        collectPreload(info, returnUnscaled);
+
     /* return if already loaded */
     if (info->image != NULL)
         return info;
 
     U4FILE *file = getImageFile(info);
-    Image *unscaled = NULL;
-    if (file) {
-        TRACE(*logger, string("loading image from file '") + info->filename + string("'"));
-
-        if (info->filetype.empty())
-            info->filetype = guessFileType(info->filename);
-        string filetype = info->filetype;
-        ImageLoader *loader = ImageLoader::getLoader(filetype);
+    if (!file) {
+        errorWarning("Failed to open file %s for reading.", info->filename.c_str());
+        return NULL;
+    }
+
+    TRACE(*logger, string("loading image from file '") + info->filename + string("'"));
+
+    setDefaults(info);
+    ImageLoader *loader = ImageLoader::getLoader(info->filetype);
+    if (loader == NULL) {
+        errorWarning("can't find loader to load image \"%s\" with type \"%s\"", info->filename.c_str(), info->filetype.c_str());
+        u4fclose(file);
+        return NULL;
+    }
+
+    if (!returnUnscaled && (settings.scale % info->prescale) != 0) {
+        int orig_scale = settings.scale;
+        settings.scale = info->prescale;
+        settings.write();
+    	errorFatal("image %s is prescaled to an incompatible size: %d\nResetting the scale to %d. Sorry about the inconvenience, please restart.", info->filename.c_str(), orig_scale, settings.scale);
+    }
+
+    int width, height;
+    info->image = load(info, loader, file, returnUnscaled, Image::HARDWARE, scalerGet(settings.filter), scaler3x(settings.filter), width, height);
+    if (info->image && info->width == -1) {
+        // Write in the values for later use.
+        info->width = width;
+        info->height = height;
+// ###            info->depth = ???
+    }
+
+    return info->image ? info : NULL;
+}
+
+/**
+ * Queues the given images, or the images holding the given subimages,
+ * to be loaded in the background.  Images that are already loaded, or
+ * whose fixups need other images or the main thread, are left to be
+ * loaded the usual way when they are first asked for; so are images
+ * that can't be opened, so that get() can report the problem.
+ */
+void ImageMgr::preload(const vector<string> &names) {
+    /* the palettes are loaded on first use, so get them in before any worker needs one */
+    U4PaletteLoader paletteLoader;
+    paletteLoader.loadBWPalette();
+    paletteLoader.loadEgaPalette();
+    paletteLoader.loadVgaPalette();
+
+    for (vector<string>::const_iterator i = names.begin(); i != names.end(); i++) {
+        ImageInfo *info = getInfo(*i);
+        if (!info) {
+            SubImage *subimage = getSubImage(*i);
+            if (subimage)
+                info = getInfo(subimage->srcImageName);
+        }
+
+        if (!info || info->image != NULL || info->filename.empty() || preloads.find(info) != preloads.end())
+            continue;
+        if (info->fixup == FIXUP_INTRO || info->fixup == FIXUP_ABYSS)
+            continue;
+
+        setDefaults(info);
+        if ((settings.scale % info->prescale) != 0)
+            continue;
+
+        ImageLoader *loader = ImageLoader::getLoader(info->filetype);
         if (loader == NULL)
-            errorWarning("can't find loader to load image \"%s\" with type \"%s\"", info->filename.c_str(), filetype.c_str());
-        else
-        {
-			unscaled = loader->load(file, info->width, info->height, info->depth);
-			if (info->width == -1) {
-				// Write in the values for later use.
-				info->width = unscaled->width();
-				info->height = unscaled->height();
-	// ###            info->depth = ???
-			}
+            continue;
+
+        U4FILE *file = getImageFile(info);
+        if (!file)
+            continue;
+
+        TRACE(*logger, string("preloading image from file '") + info->filename + string("'"));
+
+        ImageLoadJob *job = new ImageLoadJob(info, loader, file, scalerGet(settings.filter), scaler3x(settings.filter));
+        preloads[info] = job;
+        preloadOrder.push_back(info);
+        workQueue->add(job);
+    }
+}
+
+/**
+ * Waits for the oldest outstanding preload and hands its image over.
+ * Returns false once there are no preloads left.
+ */
+bool ImageMgr::finishPreload() {
+    if (preloadOrder.empty())
+        return false;
+
+    collectPreload(preloadOrder.front(), false);
+    return true;
+}
+
+/**
+ * Returns the number of images still queued by preload().
+ */
+int ImageMgr::numPreloads() const {
+    return preloadOrder.size();
+}
+
+/**
+ * Waits for the preload of an image to finish and hands the image over
+ * to its ImageInfo.  The preloaded image is scaled, so it is thrown
+ * away when the unscaled image is wanted instead.
+ */
+void ImageMgr::collectPreload(ImageInfo *info, bool returnUnscaled) {
+    ImageLoadJob *job = preloads[info];
+    workQueue->wait(job);
+
+    preloads.erase(info);
+    preloadOrder.erase(std::find(preloadOrder.begin(), preloadOrder.end(), info));
+
+    if (job->image != NULL && !returnUnscaled && info->image == NULL) {
+        info->image = Image::convert(job->image, Image::HARDWARE);
+        if (info->image != NULL && info->width == -1) {
+            info->width = job->width;
+            info->height = job->height;
         }
-        u4fclose(file);
     }
-    else
-    {
-        errorWarning("Failed to open file %s for reading.", info->filename.c_str());
-        return NULL;
+    delete job->image;
+
+    delete job;
+}
+
+/**
+ * Fills in the file type and prescale of an image if the configuration
+ * left them out.
+ */
+void ImageMgr::setDefaults(ImageInfo *info) {
+    if (info->filetype.empty())
+        info->filetype = guessFileType(info->filename);
+    if (info->prescale == 0)
+        info->prescale = 1;
+}
+
+/**
+ * Loads an image from an open file, which is closed afterwards, then
+ * applies its fixup and scales it with the given filter scaler.  The
+ * images made along the way are of the given type.  The unscaled size
+ * is returned in width and height.  Only reads the ImageInfo, so it
+ * can run on a worker thread, with software images, for any image
+ * whose fixup doesn't need other images.
+ */
+Image *ImageMgr::load(ImageInfo *info, ImageLoader *loader, U4FILE *file, bool returnUnscaled, Image::Type type, Scaler scaler, bool filter3x, int &width, int &height) {
+    PROFILE_ZONE("ImageMgr::load()");
+
+    /* the intro and abyss fixups depend on more than the file and the settings, so those are never cached */
+    string key;
+    if (!returnUnscaled && info->fixup != FIXUP_INTRO && info->fixup != FIXUP_ABYSS) {
+        key = getCacheKey(info, file);
+
+        Image *image = cache->load(getCacheEntry(info), key, type);
+        if (image != NULL) {
+            u4fclose(file);
+            int imageScale = settings.scale / info->prescale;
+            width = image->width() / imageScale;
+            height = image->height() / imageScale;
+            return image;
+        }
     }
 
+    Image *unscaled = loader->load(file, info->width, info->height, info->depth, type);
+    u4fclose(file);
+
     if (unscaled == NULL)
         return NULL;
 
+    width = unscaled->width();
+    height = unscaled->height();
+
     if (info->transparentIndex != -1)
         unscaled->setTransparentIndex(info->transparentIndex);
 
-    if (info->prescale == 0)
-        info->prescale = 1;
-
     /*
      * fixup the image before scaling it
      */
@@ -650,40 +842,77 @@ ImageInfo *ImageMgr::get(const string &name, bool returnUnscaled) {
     case FIXUP_BLACKTRANSPARENCYHACK:
         //Apply transparency shadow hack to ultima4 ega and vga upgrade classic graphics.
     	Image *unscaled_original = unscaled;
-    	unscaled = Image::duplicate(unscaled);
+    	unscaled = Image::duplicate(unscaled, type);
     	delete unscaled_original;
     	if (Settings::getInstance().enhancements && Settings::getInstance().enhancementsOptions.u4TileTransparencyHack)
     	{
-    		int transparency_shadow_size =Settings::getInstance().enhancementsOptions.u4TrileTransparencyHackShadowBreadth;
-    		int black_index = 0;
-    		int opacity = Settings::getInstance().enhancementsOptions.u4TileTransparencyHackPixelShadowOpacity;
-
+    		/* the frames don't affect each other, so share them out among the workers */
     		int frames = info->tiles;
-    		for (int f = 0; f < frames; ++f)
-    			unscaled->performTransparencyHack(black_index, frames, f, transparency_shadow_size, opacity);
+    		int nJobs = std::min(frames, workQueue->numWorkers() + 1);
+    		vector<TransparencyHackJob *> jobs;
+    		ImageLock pixelLock(unscaled);
+
+    		for (int j = 0; j < nJobs; j++) {
+    			jobs.push_back(new TransparencyHackJob(unscaled, frames, frames * j / nJobs, frames * (j + 1) / nJobs));
+    			workQueue->add(jobs.back());
+    		}
+    		for (vector<TransparencyHackJob *>::iterator j = jobs.begin(); j != jobs.end(); j++) {
+    			workQueue->wait(*j);
+    			delete *j;
+    		}
     	}
         break;
     }
 
     if (returnUnscaled)
-    {
-        info->image = unscaled;
-        return info;
-    }
-
-    int imageScale = settings.scale;
-    if ((settings.scale % info->prescale) != 0) {
-        int orig_scale = settings.scale;
-        settings.scale = info->prescale;
-        settings.write();
-    	errorFatal("image %s is prescaled to an incompatible size: %d\nResetting the scale to %d. Sorry about the inconvenience, please restart.", info->filename.c_str(), orig_scale, settings.scale);
-    }
-    imageScale /= info->prescale;
+        return unscaled;
 
-    info->image = screenScale(unscaled, imageScale, info->tiles, 1);
+    Image *image = screenScaleWith(unscaled, settings.scale / info->prescale, info->tiles, 1, scaler, filter3x, type);
 
     delete unscaled;
-    return info;
+
+    if (!key.empty())
+        cache->save(getCacheEntry(info), key, image);
+
+    return image;
+}
+
+/**
+ * Returns the name of an image's entry in the image cache.  There is
+ * one entry for each scale and filter, so switching between them
+ * doesn't throw the others away.
+ */
+string ImageMgr::getCacheEntry(ImageInfo *info) {
+    return info->name + "-" + info->filename + "-" + to_string(settings.scale) + "x-" + settings.filter;
+}
+
+/**
+ * Returns the key describing everything that goes into an image once
+ * it is loaded, fixed up and scaled: the version of its file, the way
+ * it is described in the configuration and the settings that affect
+ * it.  The file is told apart by its length and stamp rather than its
+ * contents, so that a cache hit doesn't cost reading the whole file;
+ * a file changed without its length or stamp changing is missed.
+ */
+string ImageMgr::getCacheKey(ImageInfo *info, U4FILE *file) {
+    char numbers[256];
+    sprintf(numbers, "%ld:%08lx:%dx%dx%d:%d:%d:%d:%d:%d",
+            u4flength(file), u4fstamp(file), info->width, info->height, info->depth,
+            info->prescale, info->tiles, info->transparentIndex, info->fixup, settings.scale);
+
+    string key = info->filename + ":" + info->filetype + ":" + numbers + ":" + settings.filter;
+
+    if (info->fixup == FIXUP_BLACKTRANSPARENCYHACK) {
+        const SettingsEnhancementOptions &options = settings.enhancementsOptions;
+        if (settings.enhancements && options.u4TileTransparencyHack)
+            sprintf(numbers, ":hack:%d:%d",
+                    options.u4TrileTransparencyHackShadowBreadth, options.u4TileTransparencyHackPixelShadowOpacity);
+        else
+            sprintf(numbers, ":nohack");
+        key += numbers;
+    }
+
+    return key;
 }
 
 /**
@@ -5,15 +5,20 @@
 #ifndef IMAGEMGR_H
 #define IMAGEMGR_H
 
+#include <deque>
 #include <map>
 #include <string>
 #include <vector>
 
 #include "image.h"
 #include "observer.h"
+#include "scale.h"
 
 class ConfigElement;
 class Debug;
+class ImageCache;
+class ImageLoadJob;
+class ImageLoader;
 class ImageSet;
 class Settings;
 
@@ -112,9 +117,13 @@ public:
     U4FILE * getImageFile(ImageInfo *info);
     bool imageExists(ImageInfo * info);
 
-
+    void preload(const std::vector<std::string> &names);
+    bool finishPreload();
+    int numPreloads() const;
 
 private:
+    friend class ImageLoadJob;
+
     ImageMgr();
     ~ImageMgr();
     void init();
@@ -128,6 +137,11 @@ private:
     ImageInfo *getInfoFromSet(const string &name, ImageSet *set);
 
     std::string guessFileType(const string &filename);
+    void setDefaults(ImageInfo *info);
+    std::string getCacheEntry(ImageInfo *info);
+    std::string getCacheKey(ImageInfo *info, U4FILE *file);
+    Image *load(ImageInfo *info, ImageLoader *loader, U4FILE *file, bool returnUnscaled, Image::Type type, Scaler scaler, bool filter3x, int &width, int &height);
+    void collectPreload(ImageInfo *info, bool returnUnscaled);
 
     void fixupIntro(Image *im, int prescale);
     void fixupAbyssVision(Image *im, int prescale);
@@ -141,6 +155,10 @@ private:
     std::map<std::string, ImageSet *> imageSets;
     std::vector<std::string> imageSetNames;
     ImageSet *baseSet;
+    ImageCache *cache;
+
+    std::map<ImageInfo *, ImageLoadJob *> preloads;    /**< images being loaded in the background */
+    std::deque<ImageInfo *> preloadOrder;               /**< the same images, in the order they were queued */
 
     Debug *logger;
 };
@@ -546,7 +546,7 @@ void IntroController::drawMapAnimated() {
     for (i = 0; i < IntroBinData::INTRO_BASETILE_TABLE_SIZE; i++)
         if (objectStateTable[i].tile != 0)
         {
-        	std::vector<MapTile> tiles;
+        	TileStack tiles;
         	tiles.push_back(objectStateTable[i].tile);
         	tiles.push_back(binData->introMap[objectStateTable[i].x + (objectStateTable[i].y * INTRO_MAP_WIDTH)]);
             mapArea.drawTile(tiles, false, objectStateTable[i].x, objectStateTable[i].y);
@@ -1681,11 +1681,24 @@ void IntroController::getTitleSourceData()
 
             case TITLE:
             {
+                if (titles[i].rw <= 0)
+                    break;
+
+                // read every prescale'th pixel from a row at a time
+                int span = (titles[i].rw - 1) * info->prescale + 1;
+                std::vector<uint8_t> row(span * 4);
+                ImageLock lock(titles[i].srcImage);
+
                 for (int y=0; y < titles[i].rh; y++)
                 {
+                    titles[i].srcImage->getSpanRGBA(0, y*info->prescale, span, &row[0]);
                     for (int x=0; x < titles[i].rw ; x++)
                     {
-                        titles[i].srcImage->getPixel(x*info->prescale, y*info->prescale, r, g, b, a);
+                        const uint8_t *p = &row[x * info->prescale * 4];
+                        r = p[0];
+                        g = p[1];
+                        b = p[2];
+                        a = p[3];
                         if (r || g || b)
                         {
                             AnimPlot plot = {x+1, y+1, r, g, b, a};
@@ -0,0 +1,165 @@
+/*
+ * $Id$
+ */
+
+#include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+#include "latency.h"
+
+#include "filesystem.h"
+#include "profiler.h"
+#include "settings.h"
+
+LatencyTracer *LatencyTracer::instance = NULL;
+
+LatencyHistogram::LatencyHistogram() : count(0), max(0) {
+    memset(buckets, 0, sizeof(buckets));
+}
+
+void LatencyHistogram::add(LatencyTime usecs) {
+    buckets[bucketFor(usecs)]++;
+    count++;
+    if (usecs > max)
+        max = usecs;
+}
+
+/**
+ * Returns the time that p percent of the samples don't go over,
+ * rounded up to the end of its bucket.
+ */
+LatencyTime LatencyHistogram::percentile(int p) const {
+    if (count == 0)
+        return 0;
+
+    unsigned int rank = (count * p + 99) / 100;
+    unsigned int seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank && seen > 0) {
+            LatencyTime end = i + 1 < LATENCY_BUCKETS ? bucketStart(i + 1) - 1 : max;
+            return end < max ? end : max;
+        }
+    }
+    return max;
+}
+
+int LatencyHistogram::bucketFor(LatencyTime usecs) {
+    if (usecs < LATENCY_LINEAR_BUCKETS)
+        return usecs;
+    if (usecs > 0xffffffffUL)
+        return LATENCY_BUCKETS - 1;
+
+    int log2 = 4;
+    while (log2 < 31 && (usecs >> (log2 + 1)))
+        log2++;
+    int sub = (usecs >> (log2 - 3)) & (LATENCY_SUB_BUCKETS - 1);
+    return LATENCY_LINEAR_BUCKETS + (log2 - 4) * LATENCY_SUB_BUCKETS + sub;
+}
+
+LatencyTime LatencyHistogram::bucketStart(int bucket) {
+    if (bucket < LATENCY_LINEAR_BUCKETS)
+        return bucket;
+
+    int log2 = 4 + (bucket - LATENCY_LINEAR_BUCKETS) / LATENCY_SUB_BUCKETS;
+    int sub = (bucket - LATENCY_LINEAR_BUCKETS) % LATENCY_SUB_BUCKETS;
+    return LatencyTime(LATENCY_SUB_BUCKETS + sub) << (log2 - 3);
+}
+
+/**
+ * Writes out the histograms on the way out, however the game ends.
+ */
+static void latencyWriteAtExit() {
+    if (latencyTracer->isEnabled())
+        latencyTracer->write();
+}
+
+LatencyTracer *LatencyTracer::getInstance() {
+    if (instance == NULL) {
+        instance = new LatencyTracer();
+        atexit(&latencyWriteAtExit);
+    }
+    return instance;
+}
+
+/**
+ * Returns the current time in microseconds.  Unlike SDL_GetTicks(),
+ * this is fine enough to time a single redraw.
+ */
+LatencyTime LatencyTracer::now() {
+    return LatencyTime(Profiler::now() / 1000);
+}
+
+bool LatencyTracer::isEnabled() const {
+    return settings.debug;
+}
+
+/**
+ * Adds an input that has made it to the display.  The times are when
+ * the input was taken off the event queue, when the controller was
+ * done with it, when the screen image was redrawn, and when it was
+ * pushed to the display.
+ */
+void LatencyTracer::record(const char *controllerType, LatencyTime received, LatencyTime handled, LatencyTime updated, LatencyTime presented) {
+    if (!isEnabled())
+        return;
+
+    Stats &s = stats[controllerType];
+    s.phases[LATENCY_HANDLE].add(handled - received);
+    s.phases[LATENCY_UPDATE].add(updated - handled);
+    s.phases[LATENCY_PRESENT].add(presented - updated);
+    s.phases[LATENCY_TOTAL].add(presented - received);
+}
+
+/**
+ * Returns a readable name for a type name from typeid.
+ */
+static std::string latencyTypeName(const char *name) {
+    std::string result = name;
+#if defined(__GNUC__)
+    int status;
+    char *demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+    if (demangled) {
+        result = demangled;
+        free(demangled);
+    }
+#endif
+    return result;
+}
+
+/**
+ * Writes the percentiles of every stage, for each type of controller,
+ * in milliseconds.  Returns false if the file couldn't be written.
+ */
+bool LatencyTracer::write(const std::string &filename) const {
+    static const char *phaseNames[LATENCY_PHASES] = { "handle", "update", "present", "total" };
+
+    FILE *file = FileSystem::openFile(filename, "wt");
+    if (!file)
+        return false;
+
+    std::map<std::string, const Stats *> sorted;
+    for (StatsMap::const_iterator i = stats.begin(); i != stats.end(); i++)
+        sorted[latencyTypeName(i->first)] = &i->second;
+
+    fprintf(file, "%-24s %-8s %8s %9s %9s %9s %9s\n", "controller", "phase", "samples", "p50", "p95", "p99", "max");
+    for (std::map<std::string, const Stats *>::const_iterator i = sorted.begin(); i != sorted.end(); i++) {
+        for (int phase = 0; phase < LATENCY_PHASES; phase++) {
+            const LatencyHistogram &h = i->second->phases[phase];
+            fprintf(file, "%-24s %-8s %8u %9.3f %9.3f %9.3f %9.3f\n",
+                    i->first.c_str(), phaseNames[phase], h.getCount(),
+                    h.percentile(50) / 1000.0, h.percentile(95) / 1000.0,
+                    h.percentile(99) / 1000.0, h.getMax() / 1000.0);
+        }
+    }
+
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,91 @@
+/*
+ * $Id$
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <map>
+#include <string>
+
+#define LATENCY_FILENAME "debug/latency.txt"
+
+/* 8 buckets per doubling from 16 usecs up, for about 12% precision */
+#define LATENCY_SUB_BUCKETS     8
+#define LATENCY_LINEAR_BUCKETS  16
+#define LATENCY_BUCKETS         (LATENCY_LINEAR_BUCKETS + (32 - 4) * LATENCY_SUB_BUCKETS)
+
+/** A time in microseconds, on a clock that only goes forward */
+typedef unsigned long LatencyTime;
+
+/**
+ * The stages an input goes through on its way to the screen.
+ */
+enum LatencyPhase {
+    LATENCY_HANDLE,     /**< the controller handling the input */
+    LATENCY_UPDATE,     /**< redrawing the screen image */
+    LATENCY_PRESENT,    /**< pushing the screen image to the display */
+    LATENCY_TOTAL,      /**< from the input arriving until it is on the display */
+    LATENCY_PHASES
+};
+
+/**
+ * A histogram of times, with buckets that get wider as the times get
+ * longer, so that percentiles can be read off it to within a bucket.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void add(LatencyTime usecs);
+    LatencyTime percentile(int p) const;
+
+    unsigned int getCount() const { return count; }
+    LatencyTime getMax() const { return max; }
+
+private:
+    static int bucketFor(LatencyTime usecs);
+    static LatencyTime bucketStart(int bucket);
+
+    unsigned int buckets[LATENCY_BUCKETS];
+    unsigned int count;
+    LatencyTime max;
+};
+
+/**
+ * Times inputs from the moment they are taken off the event queue
+ * until the screen they caused is on the display, and keeps a
+ * histogram of each stage for each type of controller that handled
+ * them.  Inputs that open a prompt, i.e. whose handling runs a nested
+ * event loop, aren't recorded, since they would time the player
+ * rather than the game; the inputs answering the prompt are recorded
+ * against the prompt's controller.  Only gathers anything while
+ * debugging is turned on.
+ */
+class LatencyTracer {
+public:
+    static LatencyTracer *getInstance();
+    static LatencyTime now();
+
+    bool isEnabled() const;
+    void record(const char *controllerType, LatencyTime received, LatencyTime handled, LatencyTime updated, LatencyTime presented);
+    bool write(const std::string &filename = LATENCY_FILENAME) const;
+
+private:
+    LatencyTracer() {}
+
+    /** The histograms for one type of controller */
+    struct Stats {
+        LatencyHistogram phases[LATENCY_PHASES];
+    };
+    /* keyed by the type name pointers from typeid, which are fixed for each type */
+    typedef std::map<const char *, Stats> StatsMap;
+
+    static LatencyTracer *instance;
+
+    StatsMap stats;
+};
+
+#define latencyTracer (LatencyTracer::getInstance())
+
+#endif /* LATENCY_H */
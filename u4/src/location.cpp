@@ -42,15 +42,15 @@ Location::Location(MapCoords coords, Map *map, int viewmode, LocationContext ctx
 }
 
 /**
- * Return the entire stack of objects at the given location.
+ * Fills tiles with the entire stack of objects at the given location.
  */
-std::vector<MapTile> Location::tilesAt(MapCoords coords, bool &focus) {
-    std::vector<MapTile> tiles;
-    std::list<Annotation *> a = map->annotations->ptrsToAllAt(coords);
-    std::list<Annotation *>::iterator i;
+void Location::tilesAt(MapCoords coords, bool &focus, TileStack &tiles) {
+    AnnotationMgr::View a = map->annotations->at(coords);
+    AnnotationMgr::View::const_iterator i;
     Object *obj = map->objectAt(coords);
     Creature *m = dynamic_cast<Creature *>(obj);
     focus = false;
+    tiles.clear();
 
     bool avatar = this->coords == coords;
 
@@ -63,7 +63,7 @@ std::vector<MapTile> Location::tilesAt(MapCoords coords, bool &focus) {
         else             
             tiles.push_back(*map->getTileFromData(coords));
 
-        return tiles;
+        return;
     }
 
     /* Add the avatar to gem view */
@@ -71,7 +71,7 @@ std::vector<MapTile> Location::tilesAt(MapCoords coords, bool &focus) {
         tiles.push_back(c->party->getTransport());
     
     /* Add visual-only annotations to the list */
-    for (i = a.begin(); i != a.end(); i++) {
+    for (i = a.begin(); i != a.end(); ++i) {
         if ((*i)->isVisualOnly())        
         {
             tiles.push_back((*i)->getTile());
@@ -81,7 +81,7 @@ std::vector<MapTile> Location::tilesAt(MapCoords coords, bool &focus) {
 			 * so stop here
 			 */
 			if ((*i)->isCoverUp())
-				return tiles;
+				return;
         }
     }
 
@@ -110,7 +110,7 @@ std::vector<MapTile> Location::tilesAt(MapCoords coords, bool &focus) {
         tiles.push_back(c->party->getTransport());
 
     /* then permanent annotations */
-    for (i = a.begin(); i != a.end(); i++) {
+    for (i = a.begin(); i != a.end(); ++i) {
         if (!(*i)->isVisualOnly()) {
             tiles.push_back((*i)->getTile());
 
@@ -119,7 +119,7 @@ std::vector<MapTile> Location::tilesAt(MapCoords coords, bool &focus) {
              * so stop here
              */
             if ((*i)->isCoverUp())
-            	return tiles;
+            	return;
         }
     }
 
@@ -141,8 +141,6 @@ std::vector<MapTile> Location::tilesAt(MapCoords coords, bool &focus) {
 
     	tiles.push_back(getReplacementTile(coords, tileType));
     }
-
-    return tiles;
 }
 
 
@@ -0,0 +1,326 @@
+/*
+ * $Id$
+ */
+
+#include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
+
+#include <cstring>
+
+#include "los.h"
+
+/*
+ * Line of sight is worked out on bitmasks of the viewport rather than
+ * on the tiles themselves.  Which tiles each algorithm looks at, and
+ * what it does with them, depends only on the viewport dimensions, so
+ * all of that is worked out once into tables; finding the line of
+ * sight for a frame is then a walk over the tables with a handful of
+ * bit operations per tile.
+ */
+
+#define LOS_BIT(x) (1 << (x))
+#define LOS_ALL ((1 << VIEWPORT_W) - 1)
+
+/**
+ * One step of the DOS algorithm: tile x, y is visible if any of the
+ * listed neighbours is visible and not opaque.
+ */
+struct LosStep {
+    uint8_t x, y;
+    uint8_t count;
+    uint8_t fromX[3], fromY[3];
+};
+
+/**
+ * The shadow cast by an opaque tile in the enhanced algorithm, split
+ * into its horizontal, center and vertical parts.
+ */
+struct LosShadow {
+    LosMask h, c, v;
+};
+
+static LosStep losDOSSteps[VIEWPORT_W * VIEWPORT_H];
+static int losDOSStepCount = 0;
+
+static LosShadow losShadows[VIEWPORT_W][VIEWPORT_H];
+static LosMask losCasters;
+
+static bool losInitialized = false;
+
+static void losInit();
+static void losInitDOS();
+static void losInitEnhanced();
+static void losAddStep(int x, int y, int x1, int y1, int x2 = -1, int y2 = -1, int x3 = -1, int y3 = -1);
+
+/**
+ * Finds which tiles in the viewport are visible from the avatars
+ * location in the middle. (original DOS algorithm)
+ */
+void losFindDOS(const LosMask opaque, LosMask visible) {
+    int i, j;
+
+    losInit();
+
+    memset(visible, 0, sizeof(LosMask));
+    visible[VIEWPORT_H / 2] = LOS_BIT(VIEWPORT_W / 2);
+
+    for (i = 0; i < losDOSStepCount; i++) {
+        const LosStep &step = losDOSSteps[i];
+        for (j = 0; j < step.count; j++) {
+            int y = step.fromY[j];
+            if ((visible[y] & ~opaque[y]) & LOS_BIT(step.fromX[j])) {
+                visible[step.y] |= LOS_BIT(step.x);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Finds which tiles in the viewport are visible from the avatars
+ * location in the middle, using the shadow rasters of the enhanced
+ * algorithm.  A tile is hidden when the shadows cast on it cover its
+ * horizontal face, its center and its vertical face.
+ */
+void losFindEnhanced(const LosMask opaque, LosMask visible) {
+    LosMask h, c, v;
+    int x, y, row;
+
+    losInit();
+
+    memset(h, 0, sizeof(LosMask));
+    memset(c, 0, sizeof(LosMask));
+    memset(v, 0, sizeof(LosMask));
+
+    for (y = 0; y < VIEWPORT_H; y++) {
+        int casting = opaque[y] & losCasters[y];
+        for (x = 0; casting; x++, casting >>= 1) {
+            if (!(casting & 1))
+                continue;
+            const LosShadow &shadow = losShadows[x][y];
+            for (row = 0; row < VIEWPORT_H; row++) {
+                h[row] |= shadow.h[row];
+                c[row] |= shadow.c[row];
+                v[row] |= shadow.v[row];
+            }
+        }
+    }
+
+    for (y = 0; y < VIEWPORT_H; y++)
+        visible[y] = ~(h[y] & c[y] & v[y]) & LOS_ALL;
+}
+
+/**
+ * Builds the tables for both algorithms, the first time through.
+ */
+static void losInit() {
+    if (losInitialized)
+        return;
+
+    losInitDOS();
+    losInitEnhanced();
+
+    losInitialized = true;
+}
+
+/**
+ * Records the order in which the DOS algorithm visits the viewport,
+ * and which neighbours each tile can be seen through.
+ */
+static void losInitDOS() {
+    const int cx = VIEWPORT_W / 2, cy = VIEWPORT_H / 2;
+    int x, y;
+
+    losDOSStepCount = 0;
+
+    for (x = cx - 1; x >= 0; x--)
+        losAddStep(x, cy, x + 1, cy);
+    for (x = cx + 1; x < VIEWPORT_W; x++)
+        losAddStep(x, cy, x - 1, cy);
+    for (y = cy - 1; y >= 0; y--)
+        losAddStep(cx, y, cx, y + 1);
+    for (y = cy + 1; y < VIEWPORT_H; y++)
+        losAddStep(cx, y, cx, y - 1);
+
+    for (y = cy - 1; y >= 0; y--) {
+        for (x = cx - 1; x >= 0; x--)
+            losAddStep(x, y, x, y + 1, x + 1, y, x + 1, y + 1);
+        for (x = cx + 1; x < VIEWPORT_W; x++)
+            losAddStep(x, y, x, y + 1, x - 1, y, x - 1, y + 1);
+    }
+
+    for (y = cy + 1; y < VIEWPORT_H; y++) {
+        for (x = cx - 1; x >= 0; x--)
+            losAddStep(x, y, x, y - 1, x + 1, y, x + 1, y - 1);
+        for (x = cx + 1; x < VIEWPORT_W; x++)
+            losAddStep(x, y, x, y - 1, x - 1, y, x - 1, y - 1);
+    }
+}
+
+static void losAddStep(int x, int y, int x1, int y1, int x2, int y2, int x3, int y3) {
+    LosStep &step = losDOSSteps[losDOSStepCount++];
+
+    step.x = x;
+    step.y = y;
+    step.count = 0;
+    step.fromX[step.count] = x1;
+    step.fromY[step.count++] = y1;
+    if (x2 >= 0) {
+        step.fromX[step.count] = x2;
+        step.fromY[step.count++] = y2;
+    }
+    if (x3 >= 0) {
+        step.fromX[step.count] = x3;
+        step.fromY[step.count++] = y3;
+    }
+}
+
+/**
+ * Works out the shadow each tile casts when it is opaque, by running
+ * the shadow rasters of the enhanced algorithm for every tile.
+ *
+ * Based somewhat off Andy McFadden's 1994 article,
+ *   "Improvements to a Fast Algorithm for Calculating Shading
+ *   and Visibility in a Two-Dimensional Field"
+ *   -----
+ *   http://www.fadden.com/techmisc/fast-los.html
+ *
+ * The raster table will need to be updated if the viewport dimensions
+ * increase. Also, the function assumes that the viewport width and
+ * height are odd values and that the player is always at the center
+ * of the screen.
+ */
+static void losInitEnhanced() {
+    /*
+     * the shadow rasters for each viewport octant
+     *
+     * shadowRaster[0][0]    // number of raster segments in this shadow
+     * shadowRaster[0][1]    // #1 shadow bitmask value (low three bits) + "newline" flag (high bit)
+     * shadowRaster[0][2]    // #1 length
+     * shadowRaster[0][3]    // #2 shadow bitmask value
+     * shadowRaster[0][4]    // #2 length
+     * shadowRaster[0][5]    // #3 shadow bitmask value
+     * shadowRaster[0][6]    // #3 length
+     * ...etc...
+     */
+    const int shadowRaster[14][13] = {
+        { 6, __VCH, 4, _N_CH, 1, __VCH, 3, _N___, 1, ___CH, 1, __VCH, 1 },    // raster_1_0
+        { 6, __VC_, 1, _NVCH, 2, __VC_, 1, _NVCH, 3, _NVCH, 2, _NVCH, 1 },    // raster_1_1
+        //
+        { 4, __VCH, 3, _N__H, 1, ___CH, 1, __VCH, 1,     0, 0,     0, 0 },    // raster_2_0
+        { 6, __VC_, 2, _N_CH, 1, __VCH, 2, _N_CH, 1, __VCH, 1, _N__H, 1 },    // raster_2_1
+        { 6, __V__, 1, _NVCH, 1, __VC_, 1, _NVCH, 1, __VC_, 1, _NVCH, 1 },    // raster_2_2
+        //
+        { 2, __VCH, 2, _N__H, 2,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_3_0
+        { 3, __VC_, 2, _N_CH, 1, __VCH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_1
+        { 3, __VC_, 1, _NVCH, 2, _N_CH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_2
+        { 3, _NVCH, 1, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_3
+        //
+        { 2, __VCH, 1, _N__H, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_0
+        { 2, __VC_, 1, _N__H, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_1
+        { 2, __VC_, 1, _N_CH, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_2
+        { 2, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_3
+        { 2, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0,     0, 0 }     // raster_4_4
+    };
+
+    const int _OCTANTS = 8;
+    const int _NUM_RASTERS_COLS = 4;
+
+    int octant;
+    int xOrigin, yOrigin, xSign, ySign, reflect, xTile, yTile, xTileOffset, yTileOffset;
+
+    memset(losShadows, 0, sizeof(losShadows));
+    memset(losCasters, 0, sizeof(losCasters));
+
+    for (octant = 0; octant < _OCTANTS; octant++) {
+        switch (octant) {
+            case 0:  xSign=  1;  ySign=  1;  reflect=false;  break;        // lower-right
+            case 1:  xSign=  1;  ySign=  1;  reflect=true;   break;
+            case 2:  xSign=  1;  ySign= -1;  reflect=true;   break;        // lower-left
+            case 3:  xSign= -1;  ySign=  1;  reflect=false;  break;
+            case 4:  xSign= -1;  ySign= -1;  reflect=false;  break;        // upper-left
+            case 5:  xSign= -1;  ySign= -1;  reflect=true;   break;
+            case 6:  xSign= -1;  ySign=  1;  reflect=true;   break;        // upper-right
+            default: xSign=  1;  ySign= -1;  reflect=false;  break;
+        }
+
+        // determine the origin point for the current LOS octant
+        xOrigin = VIEWPORT_W / 2;
+        yOrigin = VIEWPORT_H / 2;
+
+        // make sure the segment doesn't reach out of bounds
+        int maxWidth      = xOrigin;
+        int maxHeight     = yOrigin;
+        int currentRaster = 0;
+
+        // just in case the viewport isn't square, swap the width and height
+        if (reflect) {
+            int temp = maxWidth;
+            maxWidth = maxHeight;
+            maxHeight = temp;
+        }
+
+        // work out the shadow behind each tile, should it be opaque
+        for (int currentCol = 1; currentCol <= _NUM_RASTERS_COLS; currentCol++) {
+            for (int currentRow = 0; currentRow <= currentCol; currentRow++) {
+                // swap X and Y to reflect the octant rasters
+                if (reflect) {
+                    xTile = xOrigin+(currentRow*ySign);
+                    yTile = yOrigin+(currentCol*xSign);
+                }
+                else {
+                    xTile = xOrigin+(currentCol*xSign);
+                    yTile = yOrigin+(currentRow*ySign);
+                }
+
+                LosShadow &shadow = losShadows[xTile][yTile];
+                losCasters[yTile] |= LOS_BIT(xTile);
+
+                // the rasters are listed by column, then row
+                currentRaster = (currentCol * (currentCol + 1)) / 2 - 1 + currentRow;
+
+                xTileOffset = 0;
+                yTileOffset = 0;
+
+                for (int currentSegment = 0; currentSegment < shadowRaster[currentRaster][0]; currentSegment++) {
+                    // each shadow segment is 2 bytes
+                    int shadowType   = shadowRaster[currentRaster][currentSegment*2+1];
+                    int shadowLength = shadowRaster[currentRaster][currentSegment*2+2];
+
+                    // update the raster length to make sure it fits in the viewport
+                    shadowLength = (shadowLength+1+yTileOffset > maxWidth ? maxWidth : shadowLength);
+
+                    // check to see if we should move up a row
+                    if (shadowType & 0x80) {
+                        // remove the flag from the shadowType
+                        shadowType ^= _N___;
+                        if (currentRow + yTileOffset > maxHeight) {
+                            break;
+                        }
+                        xTileOffset = yTileOffset;
+                        yTileOffset++;
+                    }
+
+                    for (int currentShadow = 1; currentShadow <= shadowLength; currentShadow++) {
+                        int sx, sy;
+                        if (reflect) {
+                            sx = xTile + ((yTileOffset) * ySign);
+                            sy = yTile + ((currentShadow+xTileOffset) * xSign);
+                        }
+                        else {
+                            sx = xTile + ((currentShadow+xTileOffset) * xSign);
+                            sy = yTile + ((yTileOffset) * ySign);
+                        }
+
+                        if (shadowType & ____H)
+                            shadow.h[sy] |= LOS_BIT(sx);
+                        if (shadowType & ___C_)
+                            shadow.c[sy] |= LOS_BIT(sx);
+                        if (shadowType & __V__)
+                            shadow.v[sy] |= LOS_BIT(sx);
+                    }
+                    xTileOffset += shadowLength;
+                }
+            }
+        }
+    }
+}
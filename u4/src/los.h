@@ -0,0 +1,39 @@
+/*
+ * $Id$
+ */
+
+#ifndef LOS_H
+#define LOS_H
+
+#include <stdint.h>
+
+#include "u4.h"
+
+/*
+ * bitmasks for LOS shadows
+ */
+#define ____H 0x01    // obscured along the horizontal face
+#define ___C_ 0x02    // obscured at the center
+#define __V__ 0x04    // obscured along the vertical face
+#define _N___ 0x80    // start of new raster
+
+#define ___CH 0x03
+#define __VCH 0x07
+#define __VC_ 0x06
+
+#define _N__H 0x81
+#define _N_CH 0x83
+#define _NVCH 0x87
+#define _NVC_ 0x86
+#define _NV__ 0x84
+
+/**
+ * A set of viewport tiles: one row of bits per viewport row, with bit
+ * x set for column x.
+ */
+typedef uint16_t LosMask[VIEWPORT_H];
+
+void losFindDOS(const LosMask opaque, LosMask visible);
+void losFindEnhanced(const LosMask opaque, LosMask visible);
+
+#endif /* LOS_H */
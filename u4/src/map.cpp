@@ -253,11 +253,16 @@ Map::Map() {
     id = 0;
     tileset = NULL;
     tilemap = NULL;
+    objectFrontOrder = 0;
+    objectBackOrder = 0;
 }
 
 Map::~Map() {
     for (PortalList::iterator i = portals.begin(); i != portals.end(); i++)
         delete *i;
+    /* objects that outlive the map must no longer tell it when they move */
+    for (ObjectDeque::iterator i = objects.begin(); i != objects.end(); i++)
+        (*i)->removeMap(this);
     delete annotations;
 }
 
@@ -271,11 +276,12 @@ string Map::getName() {
  */
 Object *Map::objectAt(const Coords &coords) {
     /* FIXME: return a list instead of one object */
-    ObjectDeque::const_iterator i;        
+    const ObjectBucket &bucket = objectBucket(coords);
+    ObjectBucket::const_iterator i;        
     Object *objAt = NULL;    
 
-    for(i = objects.begin(); i != objects.end(); i++) {
-        Object *obj = *i;
+    for(i = bucket.begin(); i != bucket.end(); i++) {
+        Object *obj = i->obj;
         
         if (obj->getCoords() == coords) {
             /* get the most visible object */
@@ -328,18 +334,16 @@ MapTile *Map::getTileFromData(const Coords &coords) {
 MapTile *Map::tileAt(const Coords &coords, int withObjects) {
     /* FIXME: this should return a list of tiles, with the most visible at the front */
     MapTile *tile;
-    std::list<Annotation *> a = annotations->ptrsToAllAt(coords);
-    std::list<Annotation *>::iterator i;
+    AnnotationMgr::View a = annotations->at(coords);
+    AnnotationMgr::View::const_iterator i;
     Object *obj = objectAt(coords);
  
     tile = getTileFromData(coords);
 
     /* FIXME: this only returns the first valid annotation it can find */
-    if (a.size() > 0) {
-        for (i = a.begin(); i != a.end(); i++) {
-            if (!(*i)->isVisualOnly())        
-                return &(*i)->getTile();
-        }
+    for (i = a.begin(); i != a.end(); ++i) {
+        if (!(*i)->isVisualOnly())        
+            return &(*i)->getTile();
     }
 
     if ((withObjects == WITH_OBJECTS) && obj)
@@ -444,7 +448,7 @@ Creature *Map::addCreature(const Creature *creature, Coords coords) {
         m->setVisible(false);
     
     /* place the creature on the map */
-    objects.push_back(m);
+    appendObject(m);
     return m;
 }
 
@@ -452,10 +456,20 @@ Creature *Map::addCreature(const Creature *creature, Coords coords) {
  * Adds an object to the given map
  */
 Object *Map::addObject(Object *obj, Coords coords) {
+    obj->setMap(this);
     objects.push_front(obj);
+    indexObject(obj, --objectFrontOrder);
     return obj;
 }
 
+/**
+ * Adds an object to the map, after all of the objects already on it
+ */
+void Map::appendObject(Object *obj) {
+    objects.push_back(obj);
+    indexObject(obj, ++objectBackOrder);
+}
+
 Object *Map::addObject(MapTile tile, MapTile prevtile, Coords coords) {
     Object *obj = new Object;
 
@@ -466,6 +480,7 @@ Object *Map::addObject(MapTile tile, MapTile prevtile, Coords coords) {
     obj->setMap(this);
     
     objects.push_front(obj);    
+    indexObject(obj, --objectFrontOrder);
 
     return obj;
 }
@@ -482,6 +497,7 @@ void Map::removeObject(const Object *rem, bool deleteObject) {
     ObjectDeque::iterator i;
     for (i = objects.begin(); i != objects.end(); i++) {
         if (*i == rem) {
+            unindexObject(*i, (*i)->getCoords());
             /* Party members persist through different maps, so don't delete them! */
             if (!isPartyMember(*i) && deleteObject)
                 delete (*i);
@@ -492,6 +508,7 @@ void Map::removeObject(const Object *rem, bool deleteObject) {
 }
 
 ObjectDeque::iterator Map::removeObject(ObjectDeque::iterator rem, bool deleteObject) {
+    unindexObject(*rem, (*rem)->getCoords());
     /* Party members persist through different maps, so don't delete them! */
     if (!isPartyMember(*rem) && deleteObject)
         delete (*rem);
@@ -566,6 +583,72 @@ void Map::resetObjectAnimations() {
  */
 void Map::clearObjects() {
     objects.clear();    
+    for (int i = 0; i < MAP_OBJECT_BUCKETS; i++)
+        objectIndex[i].clear();
+}
+
+/**
+ * Keeps the object index up to date when an object on the map moves
+ * from the given coordinates.  Called by Object::setCoords for every
+ * map the object has been placed on, so objects that aren't (or are no
+ * longer) on this map are ignored.
+ */
+void Map::objectMoved(Object *obj, const Coords &from) {
+    long order;
+
+    if (from == obj->getCoords())
+        return;
+
+    if (unindexObject(obj, from, &order))
+        indexObject(obj, order);
+}
+
+/**
+ * Returns the bucket of the object index holding any objects at the
+ * given coordinates.  The bucket may also hold objects elsewhere, so
+ * check the coordinates of each.
+ */
+const Map::ObjectBucket &Map::objectBucket(const Coords &coords) const {
+    return objectIndex[objectBucketIndex(coords)];
+}
+
+unsigned int Map::objectBucketIndex(const Coords &coords) {
+    return coords.hash() % MAP_OBJECT_BUCKETS;
+}
+
+/**
+ * Adds an object to the index, at its current coordinates.
+ */
+void Map::indexObject(Object *obj, long order) {
+    ObjectBucket &bucket = objectIndex[objectBucketIndex(obj->getCoords())];
+    ObjectBucket::iterator i = bucket.end();
+    ObjectIndexEntry entry;
+
+    entry.obj = obj;
+    entry.order = order;
+
+    /* keep the bucket in the same order as the objects deque */
+    while (i != bucket.begin() && (i - 1)->order > order)
+        i--;
+    bucket.insert(i, entry);
+}
+
+/**
+ * Removes an object from the index, looking for it at the given
+ * coordinates.  Returns false if it wasn't there.
+ */
+bool Map::unindexObject(Object *obj, const Coords &coords, long *order) {
+    ObjectBucket &bucket = objectIndex[objectBucketIndex(coords)];
+
+    for (ObjectBucket::iterator i = bucket.begin(); i != bucket.end(); i++) {
+        if (i->obj == obj) {
+            if (order)
+                *order = i->order;
+            bucket.erase(i);
+            return true;
+        }
+    }
+    return false;
 }
 
 /**
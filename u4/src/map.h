@@ -41,6 +41,9 @@ typedef std::vector<MapTile> MapData;
 #define NO_LINE_OF_SIGHT (1 << 1)
 #define FIRST_PERSON (1 << 2)
 
+/* the number of buckets in a map's object index */
+#define MAP_OBJECT_BUCKETS 64
+
 /* mapTileAt flags */
 #define WITHOUT_OBJECTS     0
 #define WITH_GROUND_OBJECTS 1
@@ -117,9 +120,11 @@ public:
     class Creature *addCreature(const class Creature *m, Coords coords);
     class Object *addObject(MapTile tile, MapTile prevTile, Coords coords);
     class Object *addObject(Object *obj, Coords coords);
+    void appendObject(Object *obj);
     void removeObject(const class Object *rem, bool deleteObject = true);
     ObjectDeque::iterator removeObject(ObjectDeque::iterator rem, bool deleteObject = true);    
     void clearObjects();
+    void objectMoved(Object *obj, const Coords &from);
     class Creature *moveObjects(MapCoords avatar);
     void resetObjectAnimations();
     int getNumberOfCreatures();
@@ -163,6 +168,19 @@ public:
     // u4dos compatibility
     SaveGameMonsterRecord monsterTable[MONSTERTABLE_SIZE];
 
+protected:
+    /**
+     * An object in the object index.  The order of the entries
+     * follows the order of the objects in the objects deque.
+     */
+    struct ObjectIndexEntry {
+        Object *obj;
+        long order;
+    };
+    typedef std::vector<ObjectIndexEntry> ObjectBucket;
+
+    const ObjectBucket &objectBucket(const Coords &coords) const;
+
 private:
     // disallow map copying: all maps should be created and accessed
     // through the MapMgr
@@ -170,6 +188,13 @@ private:
     Map &operator=(const Map &map);
 
     void findWalkability(Coords coords, int *path_data);
+
+    static unsigned int objectBucketIndex(const Coords &coords);
+    void indexObject(Object *obj, long order);
+    bool unindexObject(Object *obj, const Coords &coords, long *order = NULL);
+
+    ObjectBucket    objectIndex[MAP_OBJECT_BUCKETS];   /**< the objects, hashed by their coordinates */
+    long            objectFrontOrder, objectBackOrder;  /**< index order for the next object pushed onto either end of objects */
 };
 
 #endif
@@ -24,6 +24,7 @@
 #include "object.h"
 #include "person.h"
 #include "portal.h"
+#include "profiler.h"
 #include "tilemap.h"
 #include "tileset.h"
 #include "u4file.h"
@@ -77,10 +78,7 @@ bool MapLoader::loadData(Map *map, U4FILE *f) {
     if (map->chunk_width == 0)
         map->chunk_width = map->width;
 
-    clock_t total = 0;
-#ifndef NPERF
-    clock_t start = clock();
-#endif
+    PROFILE_ZONE("MapLoader::loadData()");
 
     u4fseek(f, map->offset, SEEK_CUR);
 
@@ -100,26 +98,14 @@ bool MapLoader::loadData(Map *map, U4FILE *f) {
                         int c = u4fgetc(f);
                         if (c == EOF)
                             return false;
-                      
-                        clock_t s = clock();
-                        MapTile mt = map->translateFromRawTileIndex(c);
-                        total += clock() - s;
 
+                        MapTile mt = map->translateFromRawTileIndex(c);
                         map->data[x + (y * map->width) + (xch * map->chunk_width) + (ych * map->chunk_height * map->width)] = mt;
                     }
                 }
             }
         }
     }
-    
-#ifndef NPERF
-    clock_t end = clock();
-    FILE *file = FileSystem::openFile("debug/mapLoadData.txt", "wt");
-    if (file) {
-        fprintf(file, "%d msecs total\n%d msecs used by Tile::translate()", int(end - start), int(total));
-        fclose(file);
-    }
-#endif
 
     return true;
 }
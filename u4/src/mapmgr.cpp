@@ -20,6 +20,7 @@
 #include "moongate.h"
 #include "person.h"
 #include "portal.h"
+#include "profiler.h"
 #include "shrine.h"
 #include "tilemap.h"
 #include "tileset.h"
@@ -121,6 +122,7 @@ Map *MapMgr::initMap(Map::Type type) {
 Map *MapMgr::get(MapId id) {    
     /* if the map hasn't been loaded yet, load it! */
     if (!mapList[id]->data.size()) {
+        PROFILE_ZONE("MapLoader::load()");
         MapLoader *loader = MapLoader::getLoader(mapList[id]->type);
         if (loader == NULL)
             errorFatal("can't load map of type \"%d\"", mapList[id]->type);
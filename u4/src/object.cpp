@@ -12,6 +12,17 @@
 
 using namespace std;
 
+void Object::setCoords(Coords c) {
+    Coords from = coords;
+
+    prevCoords = coords;
+    coords = c;
+
+    /* let the maps we're on keep track of where we are */
+    for (unsigned int i = 0; i < maps.size(); i++)
+        maps[i]->objectMoved(this, from);
+}
+
 bool Object::setDirection(Direction d) {
     return tile.setDirection(d);
 }
@@ -21,6 +32,12 @@ void Object::setMap(class Map *m) {
         maps.push_back(m);
 }
 
+void Object::removeMap(class Map *m) {
+    std::deque<class Map *>::iterator i = find(maps.begin(), maps.end(), m);
+    if (i != maps.end())
+        maps.erase(i);
+}
+
 Map *Object::getMap() {
     if (maps.empty())
         return NULL;
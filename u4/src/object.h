@@ -53,7 +53,7 @@ public:
     void setTile(MapTile t)                 { tile = t; }
     void setTile(Tile *t)                   {tile = t->getId();}
     void setPrevTile(MapTile t)             { prevTile = t; }
-    void setCoords(Coords c)                { prevCoords = coords; coords = c; }
+    void setCoords(Coords c);
     void setPrevCoords(Coords c)            { prevCoords = c; }    
     void setMovementBehavior(ObjectMovementBehavior b)          { movement_behavior = b; }
     void setType(Type t)                    { objType = t; }
@@ -62,6 +62,7 @@ public:
     void setAnimated(bool a = true)         { animated = a; }
     
     void setMap(class Map *m);
+    void removeMap(class Map *m);
     Map *getMap();    
     void remove();  /**< Removes itself from any maps that it is a part of */
 
@@ -532,7 +532,7 @@ string Person::getQuestion(Conversation *cnv) {
 int chars_to_next_line(const char *s, int columnmax) {
     int chars = -1;
 
-    if (strlen(s) > 0) {
+    if (*s) {
         int lastbreak = columnmax;
         chars = 0;
         for (const char *str = s; *str; str++) {
@@ -572,32 +572,30 @@ int chars_needed(const char *s, int columnmax, int linesdesired, int *real_lines
     int chars = 0,
         totalChars = 0;    
 
-    char *new_str = strdup(s),
-         *str = new_str;    
+    const char *str = s;
 
-    // try breaking text into paragraphs first
+    // try breaking text into paragraphs first; only the length of
+    // the paragraphs that fit is needed, so just count it
     string text = s;
-    string paragraphs;
-    unsigned int pos;
+    string::size_type start = 0, pos;
+    unsigned int paragraphs = 0;
     int lines = 0;
-    while ((pos = text.find("\n\n")) < text.length()) {
-        string p = text.substr(0, pos);
-        lines += linecount(p.c_str(), columnmax);
+    while ((pos = text.find("\n\n", start)) != string::npos) {
+        lines += linecount(text.substr(start, pos - start), columnmax);
         if (lines <= linesdesired)
-            paragraphs += p + "\n";
+            paragraphs += pos - start + 1;
         else break;
-        text = text.substr(pos+1);
+        start = pos + 1;
     }
     // Seems to be some sort of clang compilation bug in this code, that causes this addition
     // to not work correctly.
-    int totalPossibleLines = lines + linecount(text.c_str(), columnmax);
+    int totalPossibleLines = lines + linecount(text.substr(start), columnmax);
     if (totalPossibleLines <= linesdesired)
-        paragraphs += text;
+        paragraphs += text.length() - start;
 
-    if (!paragraphs.empty()) {
+    if (paragraphs > 0) {
         *real_lines = lines;
-        free(new_str);
-        return paragraphs.length();
+        return paragraphs;
     }
     else {
         // reset variables and try another way
@@ -616,8 +614,6 @@ int chars_needed(const char *s, int columnmax, int linesdesired, int *real_lines
         str += num_to_move;
     }
 
-    free(new_str);
-
     *real_lines = lines;
     return totalChars;    
 }
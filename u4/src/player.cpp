@@ -438,7 +438,7 @@ bool PartyMember::applyDamage(int damage, bool) {
     if (isCombatMap(c->location->map) && getStatus() == STAT_DEAD) {
         Coords p = getCoords();                    
         Map *map = getMap();
-        map->annotations->add(p, Tileset::findTileByName("corpse")->getId())->setTTL(party->size() * 2);
+        map->annotations->add(p, Tileset::findTileByName("corpse")->getId(), false, false, party->size() * 2);
 
         if (party) {
             party->setChanged();
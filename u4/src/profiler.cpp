@@ -0,0 +1,253 @@
+/*
+ * $Id$
+ */
+
+#include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
+
+#include <SDL.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#include <time.h>
+#endif
+
+#include "profiler.h"
+
+#include "filesystem.h"
+
+#if defined(_MSC_VER)
+#define PROFILE_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILE_THREAD_LOCAL __thread
+#endif
+
+/**
+ * A zone that has been entered.  The end stays at zero until it has
+ * been left.
+ */
+struct ProfileEvent {
+    const char *name;
+    ProfileTime start, end;
+};
+
+/**
+ * The zones one thread has entered.  Zones that have been left go
+ * into a ring, so that once it is full the oldest are overwritten and
+ * the trace always shows the most recent stretch of the session.  The
+ * lock is only ever contended while the trace is being written.
+ */
+struct ProfileBuffer {
+    int tid;
+    std::string name;
+    SDL_mutex *mutex;
+    std::vector<ProfileEvent> events;   /**< the zones left, a ring once it holds PROFILE_MAX_EVENTS */
+    unsigned int next;                  /**< where the next zone left goes once the ring is full */
+    std::vector<ProfileEvent> open;     /**< the zones not yet left, innermost last */
+    unsigned int overwritten;
+};
+
+static PROFILE_THREAD_LOCAL ProfileBuffer *profileThreadBuffer = NULL;
+
+Profiler *Profiler::instance = NULL;
+
+Profiler *Profiler::getInstance() {
+    if (instance == NULL)
+        instance = new Profiler();
+    return instance;
+}
+
+Profiler::Profiler() : enabled(false), startTime(now()) {
+    mutex = SDL_CreateMutex();
+}
+
+/**
+ * Returns the current time in nanoseconds.
+ */
+ProfileTime Profiler::now() {
+#if defined(_WIN32)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return ProfileTime(counter.QuadPart / frequency.QuadPart) * 1000000000 +
+           ProfileTime(counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ProfileTime(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return ProfileTime(tv.tv_sec) * 1000000000 + ProfileTime(tv.tv_usec) * 1000;
+#endif
+}
+
+/**
+ * Writes the trace out on the way out, however the game ends.
+ */
+static void profilerWriteAtExit() {
+    profiler->write();
+}
+
+/**
+ * Turns recording on or off.  With NPERF, it stays off.
+ */
+void Profiler::setEnabled(bool e) {
+#ifndef NPERF
+    if (e && !enabled)
+        atexit(&profilerWriteAtExit);
+    enabled = e;
+#endif
+}
+
+/**
+ * Gives the calling thread a name to show in the trace.
+ */
+void Profiler::nameThread(const char *name) {
+    if (!enabled)
+        return;
+
+    ProfileBuffer *buffer = getThreadBuffer();
+    SDL_mutexP(buffer->mutex);
+    buffer->name = name;
+    SDL_mutexV(buffer->mutex);
+}
+
+/**
+ * Enters a zone on the calling thread.  Every begin() must be matched
+ * by an end() on the same thread.
+ */
+void Profiler::begin(const char *name) {
+    if (!enabled)
+        return;
+
+    ProfileBuffer *buffer = getThreadBuffer();
+    SDL_mutexP(buffer->mutex);
+    ProfileEvent event;
+    event.name = name;
+    event.start = now();
+    event.end = 0;
+    buffer->open.push_back(event);
+    SDL_mutexV(buffer->mutex);
+}
+
+/**
+ * Leaves the innermost zone on the calling thread.  Once the thread's
+ * ring is full, the zone takes the place of the oldest one left.
+ */
+void Profiler::end() {
+    if (!enabled)
+        return;
+
+    ProfileBuffer *buffer = getThreadBuffer();
+    SDL_mutexP(buffer->mutex);
+    if (!buffer->open.empty()) {
+        ProfileEvent event = buffer->open.back();
+        buffer->open.pop_back();
+        event.end = now();
+        if (buffer->events.size() < PROFILE_MAX_EVENTS)
+            buffer->events.push_back(event);
+        else {
+            buffer->events[buffer->next] = event;
+            buffer->next = (buffer->next + 1) % PROFILE_MAX_EVENTS;
+            buffer->overwritten++;
+        }
+    }
+    SDL_mutexV(buffer->mutex);
+}
+
+ProfileBuffer *Profiler::getThreadBuffer() {
+    if (profileThreadBuffer == NULL) {
+        ProfileBuffer *buffer = new ProfileBuffer;
+        buffer->mutex = SDL_CreateMutex();
+        buffer->next = 0;
+        buffer->overwritten = 0;
+
+        SDL_mutexP(mutex);
+        buffer->tid = buffers.size() + 1;
+        buffers.push_back(buffer);
+        SDL_mutexV(mutex);
+
+        char name[32];
+        sprintf(name, "thread %d", buffer->tid);
+        buffer->name = name;
+
+        profileThreadBuffer = buffer;
+    }
+    return profileThreadBuffer;
+}
+
+/**
+ * Writes a string as a JSON string literal.
+ */
+static void profileWriteString(FILE *file, const char *s) {
+    fputc('"', file);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', file);
+        if ((unsigned char)*s >= ' ')
+            fputc(*s, file);
+    }
+    fputc('"', file);
+}
+
+/**
+ * Writes a zone as a complete event.  A zone that hasn't been left
+ * yet is written as lasting until the given time.
+ */
+static void profileWriteEvent(FILE *file, int tid, const ProfileEvent &event, ProfileTime startTime, ProfileTime current) {
+    ProfileTime end = event.end ? event.end : current;
+    fprintf(file, ",\n{\"ph\":\"X\",\"name\":");
+    profileWriteString(file, event.name);
+    fprintf(file, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            tid, double(event.start - startTime) / 1000.0, double(end - event.start) / 1000.0);
+}
+
+/**
+ * Writes every zone recorded so far as a Chrome trace.  Zones that
+ * haven't been left yet are written as lasting until now.  Returns
+ * false if the file couldn't be written.
+ */
+bool Profiler::write(const std::string &filename) {
+    if (!enabled)
+        return false;
+
+    FILE *file = FileSystem::openFile(filename, "wt");
+    if (!file)
+        return false;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+
+    SDL_mutexP(mutex);
+    for (std::vector<ProfileBuffer *>::iterator i = buffers.begin(); i != buffers.end(); i++) {
+        ProfileBuffer *buffer = *i;
+        SDL_mutexP(buffer->mutex);
+        ProfileTime current = now();
+
+        fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", buffer->tid);
+        profileWriteString(file, buffer->name.c_str());
+        fprintf(file, "}}");
+        first = false;
+
+        for (std::vector<ProfileEvent>::const_iterator e = buffer->events.begin(); e != buffer->events.end(); e++)
+            profileWriteEvent(file, buffer->tid, *e, startTime, current);
+        for (std::vector<ProfileEvent>::const_iterator e = buffer->open.begin(); e != buffer->open.end(); e++)
+            profileWriteEvent(file, buffer->tid, *e, startTime, current);
+
+        if (buffer->overwritten > 0)
+            fprintf(stderr, "profiler: %s overwrote its %u oldest zones\n", buffer->name.c_str(), buffer->overwritten);
+        SDL_mutexV(buffer->mutex);
+    }
+    SDL_mutexV(mutex);
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
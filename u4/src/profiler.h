@@ -0,0 +1,88 @@
+/*
+ * $Id$
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+
+struct SDL_mutex;
+struct ProfileBuffer;
+
+#define PROFILE_FILENAME "debug/trace.json"
+#define PROFILE_MAX_EVENTS 262144   /* per thread; the oldest zones are overwritten */
+
+/** A time in nanoseconds, on a clock that only goes forward */
+#if defined(_MSC_VER)
+typedef unsigned __int64 ProfileTime;
+#else
+typedef unsigned long long ProfileTime;
+#endif
+
+/**
+ * Records how long the game spends in named zones of code.  Zones
+ * nest, and each thread records into its own buffer, so worker
+ * threads don't get in each other's way.  The result is written out
+ * in the Chrome trace event format, which chrome://tracing and
+ * Perfetto can show as a timeline.  Only records anything while
+ * debugging is turned on.
+ */
+class Profiler {
+public:
+    static Profiler *getInstance();
+    static ProfileTime now();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+    void nameThread(const char *name);
+    void begin(const char *name);
+    void end();
+    bool write(const std::string &filename = PROFILE_FILENAME);
+
+private:
+    Profiler();
+
+    ProfileBuffer *getThreadBuffer();
+
+    static Profiler *instance;
+
+    bool enabled;
+    ProfileTime startTime;
+    SDL_mutex *mutex;                       /**< guards the list of buffers */
+    std::vector<ProfileBuffer *> buffers;   /**< one for each thread that has recorded anything */
+};
+
+#define profiler (Profiler::getInstance())
+
+/**
+ * A zone that lasts as long as the object does.  Use PROFILE_ZONE()
+ * rather than this directly, so that it goes away with NPERF.
+ */
+class ProfileZone {
+public:
+    ProfileZone(const char *name) : active(profiler->isEnabled()) {
+        if (active)
+            profiler->begin(name);
+    }
+    ~ProfileZone() {
+        if (active)
+            profiler->end();
+    }
+
+private:
+    bool active;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
+/* names must be string literals, as only the pointer is kept */
+#ifndef NPERF
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#endif /* PROFILER_H */
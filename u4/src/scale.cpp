@@ -4,18 +4,36 @@
 
 #include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
 
+#include <cstring>
+#include <vector>
+
 #include "debug.h"
 #include "image.h"
 #include "scale.h"
 
+#if defined(__SSE2__)
+#define SCALE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SCALE_NEON 1
+#include <arm_neon.h>
+#endif
+
 using std::string;
+using std::vector;
 
-Image *scalePoint(Image *src, int scale, int n);
-Image *scale2xBilinear(Image *src, int scale, int n);
-Image *scale2xSaI(Image *src, int scale, int N);
-Image *scaleScale2x(Image *src, int scale, int N);
+Image *scalePoint(Image *src, int scale, int n, Image::Type type);
+Image *scale2xBilinear(Image *src, int scale, int n, Image::Type type);
+Image *scale2xSaI(Image *src, int scale, int N, Image::Type type);
+Image *scaleScale2x(Image *src, int scale, int N, Image::Type type);
+
+static void scaleInitKernels();
 
 Scaler scalerGet(const string &filter) {
+    scaleInitKernels();
+
     if (filter == "point")
         return &scalePoint;
     else if (filter == "2xBi")
@@ -35,30 +53,329 @@ int scaler3x(const string &filter) {
     return filter == "Scale2x";
 }
 
+/*
+ * The scalers work a row at a time directly on the image memory.
+ * 8-bit images hold palette indexes; 32-bit images (as created by
+ * Image::create) hold RGBA pixels with the channels stored in that
+ * order in memory, whatever the byte order of the machine.  Rows are
+ * converted to 32-bit RGBA whenever a scaler needs to look at the
+ * colors themselves.
+ *
+ * The simple per-row kernels (pixel doubling and bilinear
+ * interpolation) have a portable version, plus SSE2 and NEON
+ * versions that are used when the compiler targets those instruction
+ * sets.  The choice is made at compile time, so a build for SSE2 or
+ * NEON needs a CPU that has them.
+ */
+
+/**
+ * Packs a color into a 32-bit RGBA pixel.
+ */
+static uint32_t scalePack(unsigned int r, unsigned int g, unsigned int b, unsigned int a) {
+    uint8_t bytes[4];
+    uint32_t pixel;
+
+    bytes[0] = r;
+    bytes[1] = g;
+    bytes[2] = b;
+    bytes[3] = a;
+    memcpy(&pixel, bytes, sizeof(pixel));
+    return pixel;
+}
+
+/**
+ * Per channel average of two pixels, rounded down.
+ */
+static inline uint32_t scaleAverage2(uint32_t a, uint32_t b) {
+    return (a & b) + (((a ^ b) & 0xfefefefe) >> 1);
+}
+
+/**
+ * Per channel average of four pixels, rounded down.
+ */
+static inline uint32_t scaleAverage4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    uint32_t high = ((a >> 2) & 0x3f3f3f3f) + ((b >> 2) & 0x3f3f3f3f) + ((c >> 2) & 0x3f3f3f3f) + ((d >> 2) & 0x3f3f3f3f);
+    uint32_t low = (a & 0x03030303) + (b & 0x03030303) + (c & 0x03030303) + (d & 0x03030303);
+    return high + ((low >> 2) & 0x03030303);
+}
+
+/**
+ * Builds a table mapping each palette index of an indexed image to
+ * its RGBA pixel.
+ */
+static void scaleBuildPaletteTable(Image *src, uint32_t table[256]) {
+    for (int i = 0; i < 256; i++) {
+        RGBA color = src->getPaletteColor(i);
+        table[i] = scalePack(color.r, color.g, color.b, IM_OPAQUE);
+    }
+}
+
+/**
+ * Reads row y of an image as 32-bit RGBA pixels.
+ */
+static void scaleFetchRow(Image *src, int y, const uint32_t *palette, uint32_t *dest) {
+    int x, w = src->width();
+
+    switch (src->bytesPerPixel()) {
+    case 1:
+        {
+            const uint8_t *row = src->getRow8(y);
+            for (x = 0; x < w; x++)
+                dest[x] = palette[row[x]];
+        }
+        break;
+
+    case 4:
+        memcpy(dest, src->getRow32(y), w * sizeof(uint32_t));
+        break;
+
+    default:
+        /* scalePack keeps the bytes in RGBA order too */
+        src->getSpanRGBA(0, y, w, reinterpret_cast<uint8_t *>(dest));
+        break;
+    }
+}
+
+/**
+ * Portable row kernels.
+ */
+static void scaleDoubleRow8(const uint8_t *src, uint8_t *dest, int w) {
+    for (int x = 0; x < w; x++)
+        dest[x * 2] = dest[x * 2 + 1] = src[x];
+}
+
+static void scaleDoubleRow32(const uint32_t *src, uint32_t *dest, int w) {
+    for (int x = 0; x < w; x++)
+        dest[x * 2] = dest[x * 2 + 1] = src[x];
+}
+
+/**
+ * Produces the two destination rows of the 2x bilinear scaler from
+ * the source row and the one below it, starting at pixel x.
+ */
+static void scaleBilinearTail(const uint32_t *row, const uint32_t *below, uint32_t *dest0, uint32_t *dest1, int x, int w) {
+    for (; x < w; x++) {
+        int xoff = (x == w - 1) ? 0 : 1;
+        uint32_t a = row[x];
+        uint32_t b = row[x + xoff];
+        uint32_t c = below[x];
+        uint32_t d = below[x + xoff];
+
+        dest0[x * 2] = a;
+        dest0[x * 2 + 1] = scaleAverage2(a, b);
+        dest1[x * 2] = scaleAverage2(a, c);
+        dest1[x * 2 + 1] = scaleAverage4(a, b, c, d);
+    }
+}
+
+static void scaleBilinearRow(const uint32_t *row, const uint32_t *below, uint32_t *dest0, uint32_t *dest1, int w) {
+    scaleBilinearTail(row, below, dest0, dest1, 0, w);
+}
+
+#ifdef SCALE_SSE2
+/**
+ * SSE2 row kernels.
+ */
+static void scaleDoubleRow8SSE2(const uint8_t *src, uint8_t *dest, int w) {
+    int x;
+    for (x = 0; x + 16 <= w; x += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * 2), _mm_unpacklo_epi8(v, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * 2 + 16), _mm_unpackhi_epi8(v, v));
+    }
+    scaleDoubleRow8(src + x, dest + x * 2, w - x);
+}
+
+static void scaleDoubleRow32SSE2(const uint32_t *src, uint32_t *dest, int w) {
+    int x;
+    for (x = 0; x + 4 <= w; x += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * 2), _mm_unpacklo_epi32(v, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + x * 2 + 4), _mm_unpackhi_epi32(v, v));
+    }
+    scaleDoubleRow32(src + x, dest + x * 2, w - x);
+}
+
+static inline __m128i scaleAverage2SSE2(__m128i a, __m128i b) {
+    /* _mm_avg_epu8 rounds up; take the odd bit back off */
+    __m128i odd = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+    return _mm_sub_epi8(_mm_avg_epu8(a, b), odd);
+}
+
+static inline __m128i scaleAverage4SSE2(__m128i a, __m128i b, __m128i c, __m128i d) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+                                _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero)));
+    __m128i high = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+                                 _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero)));
+    return _mm_packus_epi16(_mm_srli_epi16(low, 2), _mm_srli_epi16(high, 2));
+}
+
+static void scaleBilinearRowSSE2(const uint32_t *row, const uint32_t *below, uint32_t *dest0, uint32_t *dest1, int w) {
+    int x;
+
+    /* the last pixel has no right hand neighbour; leave it to the tail */
+    for (x = 0; x + 4 < w; x += 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x + 1));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(below + x));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(below + x + 1));
+        __m128i ab = scaleAverage2SSE2(a, b);
+        __m128i ac = scaleAverage2SSE2(a, c);
+        __m128i abcd = scaleAverage4SSE2(a, b, c, d);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest0 + x * 2), _mm_unpacklo_epi32(a, ab));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest0 + x * 2 + 4), _mm_unpackhi_epi32(a, ab));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest1 + x * 2), _mm_unpacklo_epi32(ac, abcd));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dest1 + x * 2 + 4), _mm_unpackhi_epi32(ac, abcd));
+    }
+    scaleBilinearTail(row, below, dest0, dest1, x, w);
+}
+#endif /* SCALE_SSE2 */
+
+#ifdef SCALE_NEON
+/**
+ * NEON row kernels.
+ */
+static void scaleDoubleRow8NEON(const uint8_t *src, uint8_t *dest, int w) {
+    int x;
+    for (x = 0; x + 16 <= w; x += 16) {
+        uint8x16x2_t pair;
+        pair.val[0] = pair.val[1] = vld1q_u8(src + x);
+        vst2q_u8(dest + x * 2, pair);
+    }
+    scaleDoubleRow8(src + x, dest + x * 2, w - x);
+}
+
+static void scaleDoubleRow32NEON(const uint32_t *src, uint32_t *dest, int w) {
+    int x;
+    for (x = 0; x + 4 <= w; x += 4) {
+        uint32x4x2_t pair;
+        pair.val[0] = pair.val[1] = vld1q_u32(src + x);
+        vst2q_u32(dest + x * 2, pair);
+    }
+    scaleDoubleRow32(src + x, dest + x * 2, w - x);
+}
+
+static inline uint8x16_t scaleAverage4NEON(uint8x16_t a, uint8x16_t b, uint8x16_t c, uint8x16_t d) {
+    uint16x8_t low = vaddq_u16(vaddl_u8(vget_low_u8(a), vget_low_u8(b)),
+                               vaddl_u8(vget_low_u8(c), vget_low_u8(d)));
+    uint16x8_t high = vaddq_u16(vaddl_u8(vget_high_u8(a), vget_high_u8(b)),
+                                vaddl_u8(vget_high_u8(c), vget_high_u8(d)));
+    return vcombine_u8(vshrn_n_u16(low, 2), vshrn_n_u16(high, 2));
+}
+
+static void scaleBilinearRowNEON(const uint32_t *row, const uint32_t *below, uint32_t *dest0, uint32_t *dest1, int w) {
+    int x;
+
+    /* the last pixel has no right hand neighbour; leave it to the tail */
+    for (x = 0; x + 4 < w; x += 4) {
+        uint8x16_t a = vreinterpretq_u8_u32(vld1q_u32(row + x));
+        uint8x16_t b = vreinterpretq_u8_u32(vld1q_u32(row + x + 1));
+        uint8x16_t c = vreinterpretq_u8_u32(vld1q_u32(below + x));
+        uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(below + x + 1));
+        uint32x4x2_t top, bottom;
+
+        top.val[0] = vreinterpretq_u32_u8(a);
+        top.val[1] = vreinterpretq_u32_u8(vhaddq_u8(a, b));
+        bottom.val[0] = vreinterpretq_u32_u8(vhaddq_u8(a, c));
+        bottom.val[1] = vreinterpretq_u32_u8(scaleAverage4NEON(a, b, c, d));
+        vst2q_u32(dest0 + x * 2, top);
+        vst2q_u32(dest1 + x * 2, bottom);
+    }
+    scaleBilinearTail(row, below, dest0, dest1, x, w);
+}
+#endif /* SCALE_NEON */
+
+/**
+ * The row kernels in use; chosen once, according to what the CPU
+ * supports.
+ */
+static struct {
+    bool initialized;
+    void (*doubleRow8)(const uint8_t *src, uint8_t *dest, int w);
+    void (*doubleRow32)(const uint32_t *src, uint32_t *dest, int w);
+    void (*bilinearRow)(const uint32_t *row, const uint32_t *below, uint32_t *dest0, uint32_t *dest1, int w);
+} kernels = { false, NULL, NULL, NULL };
+
+static void scaleInitKernels() {
+    if (kernels.initialized)
+        return;
+
+    kernels.doubleRow8 = &scaleDoubleRow8;
+    kernels.doubleRow32 = &scaleDoubleRow32;
+    kernels.bilinearRow = &scaleBilinearRow;
+
+#ifdef SCALE_SSE2
+    kernels.doubleRow8 = &scaleDoubleRow8SSE2;
+    kernels.doubleRow32 = &scaleDoubleRow32SSE2;
+    kernels.bilinearRow = &scaleBilinearRowSSE2;
+#endif
+
+#ifdef SCALE_NEON
+    kernels.doubleRow8 = &scaleDoubleRow8NEON;
+    kernels.doubleRow32 = &scaleDoubleRow32NEON;
+    kernels.bilinearRow = &scaleBilinearRowNEON;
+#endif
+
+    kernels.initialized = true;
+}
+
 /**
  * A simple row and column duplicating scaler.
  */
-Image *scalePoint(Image *src, int scale, int n) {
+Image *scalePoint(Image *src, int scale, int n, Image::Type type) {
     int x, y, i, j;
     Image *dest;
 
-    dest = Image::create(src->width() * scale, src->height() * scale, src->isIndexed(), Image::HARDWARE);
+    dest = Image::create(src->width() * scale, src->height() * scale, src->isIndexed(), type);
     if (!dest)
         return NULL;
 
     if (dest->isIndexed())
         dest->setPaletteFromImage(src);
 
+    int bpp = src->bytesPerPixel();
+    if (bpp != dest->bytesPerPixel() || (bpp != 1 && bpp != 4)) {
+        std::vector<unsigned int> srcRow(src->width()), destRow(dest->width());
+        for (y = 0; y < src->height(); y++) {
+            src->getSpan(0, y, src->width(), &srcRow[0]);
+            for (x = 0; x < dest->width(); x++)
+                destRow[x] = srcRow[x / scale];
+            for (i = 0; i < scale; i++)
+                dest->putSpan(0, y * scale + i, dest->width(), &destRow[0]);
+        }
+        return dest;
+    }
+
+    /* widen each source row into the first of its destination rows, then copy it down */
     for (y = 0; y < src->height(); y++) {
-        for (x = 0; x < src->width(); x++) {
-            for (i = 0; i < scale; i++) {
-                for (j = 0; j < scale; j++) {
-                    unsigned int index;
-                    src->getPixelIndex(x, y, index);
-                    dest->putPixelIndex(x * scale + j, y * scale + i, index);
+        uint8_t *first = dest->getRow8(y * scale);
+
+        if (bpp == 1) {
+            const uint8_t *row = src->getRow8(y);
+            if (scale == 2)
+                kernels.doubleRow8(row, first, src->width());
+            else {
+                for (x = 0; x < src->width(); x++)
+                    memset(first + x * scale, row[x], scale);
+            }
+        }
+        else {
+            const uint32_t *row = src->getRow32(y);
+            uint32_t *out = reinterpret_cast<uint32_t *>(first);
+            if (scale == 2)
+                kernels.doubleRow32(row, out, src->width());
+            else {
+                for (x = 0; x < src->width(); x++) {
+                    for (j = 0; j < scale; j++)
+                        *out++ = row[x];
                 }
             }
         }
+
+        for (i = 1; i < scale; i++)
+            memcpy(dest->getRow8(y * scale + i), first, dest->width() * bpp);
     }
 
     return dest;
@@ -68,15 +385,14 @@ Image *scalePoint(Image *src, int scale, int n) {
  * A scaler that interpolates each intervening pixel from it's two
  * neighbors.
  */
-Image *scale2xBilinear(Image *src, int scale, int n) {
-    int i, x, y, xoff, yoff;
-    RGBA a, b, c, d;
+Image *scale2xBilinear(Image *src, int scale, int n, Image::Type type) {
+    int i, y, yoff;
     Image *dest;
 
     /* this scaler works only with images scaled by 2x */
     ASSERT(scale == 2, "invalid scale: %d", scale);
-    
-    dest = Image::create(src->width() * scale, src->height() * scale, false, Image::HARDWARE);
+
+    dest = Image::create(src->width() * scale, src->height() * scale, false, type);
     if (!dest)
         return NULL;
 
@@ -93,6 +409,13 @@ Image *scale2xBilinear(Image *src, int scale, int n) {
      * [(A+C)/2] [(A+B+C+D)/4]
      */
 
+    int w = src->width();
+    uint32_t palette[256];
+    vector<uint32_t> row(w), below(w);
+
+    if (src->isIndexed())
+        scaleBuildPaletteTable(src, palette);
+
     for (i = 0; i < n; i++) {
         for (y = (src->height() / n) * i; y < (src->height() / n) * (i + 1); y++) {
             if (y == (src->height() / n) * (i + 1) - 1)
@@ -100,62 +423,35 @@ Image *scale2xBilinear(Image *src, int scale, int n) {
             else
                 yoff = 1;
 
-            for (x = 0; x < src->width(); x++) {
-                if (x == src->width() - 1)
-                    xoff = 0;
-                else
-                    xoff = 1;
-
-                src->getPixel(x, y, a.r, a.g, a.b, a.a);
-                src->getPixel(x + xoff, y, b.r, b.g, b.b, b.a);
-                src->getPixel(x, y + yoff, c.r, c.g, c.b, c.a);
-                src->getPixel(x + xoff, y + yoff, d.r, d.g, d.b, d.a);
+            scaleFetchRow(src, y, palette, &row[0]);
+            if (yoff)
+                scaleFetchRow(src, y + yoff, palette, &below[0]);
 
-                dest->putPixel(x * 2, y * 2, a.r, a.g, a.b, a.a);
-                dest->putPixel(x * 2 + 1, y * 2, (a.r + b.r) >> 1, (a.g + b.g) >> 1, (a.b + b.b) >> 1, (a.a + b.a) >> 1);
-                dest->putPixel(x * 2, y * 2 + 1, (a.r + c.r) >> 1, (a.g + c.g) >> 1, (a.b + c.b) >> 1, (a.a + c.a) >> 1);
-                dest->putPixel(x * 2 + 1, y * 2 + 1, (a.r + b.r + c.r + d.r) >> 2, (a.g + b.g + c.g + d.g) >> 2, (a.b + b.b + c.b + d.b) >> 2, (a.a + b.a + c.a + d.a) >> 2);                
-            }
+            kernels.bilinearRow(&row[0], yoff ? &below[0] : &row[0],
+                                dest->getRow32(y * 2), dest->getRow32(y * 2 + 1), w);
         }
-    }    
+    }
 
     return dest;
 }
 
-int colorEqual(RGBA a, RGBA b) {
-    return
-        a.r == b.r &&
-        a.g == b.g &&
-        a.b == b.b &&
-        a.a == b.a;
-}
-
-RGBA colorAverage(RGBA a, RGBA b) {
-    RGBA result;
-    result.r = (a.r + b.r) >> 1;
-    result.g = (a.g + b.g) >> 1;
-    result.b = (a.b + b.b) >> 1;
-    result.a = (a.a + b.a) >> 1;
-    return result;
-}
-
-int _2xSaI_GetResult1(RGBA a, RGBA b, RGBA c, RGBA d) {
+int _2xSaI_GetResult1(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
     int x = 0;
     int y = 0;
     int r = 0;
-    if (colorEqual(a, c)) x++; else if (colorEqual(b, c)) y++;
-    if (colorEqual(a, d)) x++; else if (colorEqual(b, d)) y++;
+    if (a == c) x++; else if (b == c) y++;
+    if (a == d) x++; else if (b == d) y++;
     if (x <= 1) r++;
     if (y <= 1) r--;
     return r;
 }
 
-int _2xSaI_GetResult2(RGBA a, RGBA b, RGBA c, RGBA d) {
+int _2xSaI_GetResult2(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
     int x = 0;
     int y = 0;
     int r = 0;
-    if (colorEqual(a, c)) x++; else if (colorEqual(b, c)) y++;
-    if (colorEqual(a, d)) x++; else if (colorEqual(b, d)) y++;
+    if (a == c) x++; else if (b == c) y++;
+    if (a == d) x++; else if (b == d) y++;
     if (x <= 1) r--;
     if (y <= 1) r++;
     return r;
@@ -165,16 +461,16 @@ int _2xSaI_GetResult2(RGBA a, RGBA b, RGBA c, RGBA d) {
  * A more sophisticated scaler that interpolates each new pixel the
  * surrounding pixels.
  */
-Image *scale2xSaI(Image *src, int scale, int N) {
+Image *scale2xSaI(Image *src, int scale, int N, Image::Type type) {
     int ii, x, y, xoff0, xoff1, xoff2, yoff0, yoff1, yoff2;
-    RGBA a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p;
-    RGBA prod0, prod1, prod2;
+    uint32_t a, b, c, d, e, f, g, h, i, j, k, l, m, n, o;
+    uint32_t prod0, prod1, prod2;
     Image *dest;
 
     /* this scaler works only with images scaled by 2x */
     ASSERT(scale == 2, "invalid scale: %d", scale);
-    
-    dest = Image::create(src->width() * scale, src->height() * scale, false, Image::HARDWARE);
+
+    dest = Image::create(src->width() * scale, src->height() * scale, false, type);
     if (!dest)
         return NULL;
 
@@ -189,6 +485,20 @@ Image *scale2xSaI(Image *src, int scale, int N) {
      * M N O P
      */
 
+    int w = src->width();
+    uint32_t palette[256];
+    vector<uint32_t> rows(w * 4);
+    const uint32_t alphaMask = scalePack(0, 0, 0, 0xff);
+
+    if (src->isIndexed())
+        scaleBuildPaletteTable(src, palette);
+
+    /*
+     * prod2 keeps its alpha from one pixel to the next when only its
+     * color channels are interpolated
+     */
+    prod2 = alphaMask;
+
     for (ii = 0; ii < N; ii++) {
         for (y = (src->height() / N) * ii; y < (src->height() / N) * (ii + 1); y++) {
             if (y == 0)
@@ -208,17 +518,25 @@ Image *scale2xSaI(Image *src, int scale, int N) {
                 yoff2 = 2;
             }
 
+            const uint32_t *above = &rows[0], *row = &rows[w], *below = &rows[w * 2], *below2 = &rows[w * 3];
+            scaleFetchRow(src, y + yoff0, palette, &rows[0]);
+            scaleFetchRow(src, y, palette, &rows[w]);
+            scaleFetchRow(src, y + yoff1, palette, &rows[w * 2]);
+            scaleFetchRow(src, y + yoff2, palette, &rows[w * 3]);
+
+            uint32_t *dest0 = dest->getRow32(y << 1);
+            uint32_t *dest1 = dest->getRow32((y << 1) + 1);
 
-            for (x = 0; x < src->width(); x++) {
+            for (x = 0; x < w; x++) {
                 if (x == 0)
                     xoff0 = 0;
                 else
                     xoff0 = -1;
-                if (x == src->width() - 1) {
+                if (x == w - 1) {
                     xoff1 = 0;
                     xoff2 = 0;
                 }
-                else if (x == src->width() - 2) {
+                else if (x == w - 2) {
                     xoff1 = 1;
                     xoff2 = 1;
                 }
@@ -227,63 +545,62 @@ Image *scale2xSaI(Image *src, int scale, int N) {
                     xoff2 = 2;
                 }
 
-                src->getPixel(x, y, a.r, a.g, a.b, a.a);
-                src->getPixel(x + xoff1, y, b.r, b.g, b.b, b.a);
-                src->getPixel(x, y + yoff1, c.r, c.g, c.b, c.a);
-                src->getPixel(x + xoff1, y + yoff1, d.r, d.g, d.b, d.a);
-
-                src->getPixel(x, y + yoff0, e.r, e.g, e.b, e.a);
-                src->getPixel(x + xoff1, y + yoff0, f.r, f.g, f.b, f.a);
-                src->getPixel(x + xoff0, y, g.r, g.g, g.b, g.a);
-                src->getPixel(x + xoff0, y + yoff1, h.r, h.g, h.b, h.a);
-
-                src->getPixel(x + xoff0, y + yoff0, i.r, i.g, i.b, i.a);
-                src->getPixel(x + xoff2, y + yoff0, j.r, j.g, j.b, j.a);
-                src->getPixel(x + xoff0, y, k.r, k.g, k.b, k.a);
-                src->getPixel(x + xoff0, y + yoff1, l.r, l.g, l.b, l.a);
-
-                src->getPixel(x + xoff0, y + yoff2, m.r, m.g, m.b, m.a);
-                src->getPixel(x, y + yoff2, n.r, n.g, n.b, n.a);
-                src->getPixel(x + xoff1, y + yoff2, o.r, o.g, o.b, o.a);
-                src->getPixel(x + xoff2, y + yoff2, p.r, p.g, p.b, p.a);
-
-                if (colorEqual(a, d) && !colorEqual(b, c)) {
-                    if ((colorEqual(a, e) && colorEqual(b, l)) ||
-                        (colorEqual(a, c) && colorEqual(a, f) && !colorEqual(b, e) && colorEqual(b, j)))
+                a = row[x];
+                b = row[x + xoff1];
+                c = below[x];
+                d = below[x + xoff1];
+
+                e = above[x];
+                f = above[x + xoff1];
+                g = row[x + xoff0];
+                h = below[x + xoff0];
+
+                i = above[x + xoff0];
+                j = above[x + xoff2];
+                k = row[x + xoff0];
+                l = below[x + xoff0];
+
+                m = below2[x + xoff0];
+                n = below2[x];
+                o = below2[x + xoff1];
+
+                if (a == d && b != c) {
+                    if ((a == e && b == l) ||
+                        (a == c && a == f && b != e && b == j))
                         prod0 = a;
                     else
-                        prod0 = colorAverage(a, b);
+                        prod0 = scaleAverage2(a, b);
 
-                    if ((colorEqual(a, g) && colorEqual(c, o)) ||
-                        (colorEqual(a, b) && colorEqual(a, h) && !colorEqual(g, c) && colorEqual(c, m)))
+                    if ((a == g && c == o) ||
+                        (a == b && a == h && g != c && c == m))
                         prod1 = a;
                     else
-                        prod1 = colorAverage(a, c);
+                        prod1 = scaleAverage2(a, c);
 
                     prod2 = a;
                 }
-                else if (colorEqual(b, c) && !colorEqual(a, d)) {
-                    if ((colorEqual(b, f) && colorEqual(a, h)) ||
-                        (colorEqual(b, e) && colorEqual(b, d) && !colorEqual(a, f) && colorEqual(a, i)))
+                else if (b == c && a != d) {
+                    if ((b == f && a == h) ||
+                        (b == e && b == d && a != f && a == i))
                         prod0 = b;
                     else
-                        prod0 = colorAverage(a, b);
+                        prod0 = scaleAverage2(a, b);
 
-                    if ((colorEqual(c, h) && colorEqual(a, f)) ||
-                        (colorEqual(c, g) && colorEqual(c, d) && !colorEqual(a, h) && colorEqual(a, i)))
+                    if ((c == h && a == f) ||
+                        (c == g && c == d && a != h && a == i))
                         prod1 = c;
                     else
-                        prod1 = colorAverage(a, c);
+                        prod1 = scaleAverage2(a, c);
 
                     prod2 = b;
                 }
-                else if (colorEqual(a, d) && colorEqual(b, c)) {
-                    if (colorEqual(a, b))
+                else if (a == d && b == c) {
+                    if (a == b)
                         prod0 = prod1 = prod2 = a;
                     else {
                         int r = 0;
-                        prod0 = colorAverage(a, b);
-                        prod1 = colorAverage(a, c);
+                        prod0 = scaleAverage2(a, b);
+                        prod1 = scaleAverage2(a, c);
 
                         r += _2xSaI_GetResult1(a, b, g, e);
                         r += _2xSaI_GetResult2(b, a, k, f);
@@ -294,38 +611,32 @@ Image *scale2xSaI(Image *src, int scale, int N) {
                             prod2 = a;
                         else if (r < 0)
                             prod2 = b;
-                        else {
-                            prod2.r = (a.r + b.r + c.r + d.r) >> 2;
-                            prod2.g = (a.g + b.g + c.g + d.g) >> 2;
-                            prod2.b = (a.b + b.b + c.b + d.b) >> 2;
-                        }
+                        else
+                            prod2 = (scaleAverage4(a, b, c, d) & ~alphaMask) | (prod2 & alphaMask);
                     }
                 }
                 else {
-                    if (colorEqual(a, c) && colorEqual(a, f) && !colorEqual(b, e) && colorEqual(b, j))
+                    if (a == c && a == f && b != e && b == j)
                         prod0 = a;
-                    else if (colorEqual(b, e) && colorEqual(b, d) && !colorEqual(a, f) && colorEqual(a, i))
+                    else if (b == e && b == d && a != f && a == i)
                         prod0 = b;
                     else
-                        prod0 = colorAverage(a, b);
+                        prod0 = scaleAverage2(a, b);
 
-                    if (colorEqual(a, b) && colorEqual(a, h) && !colorEqual(g, c) && colorEqual(c, m))
+                    if (a == b && a == h && g != c && c == m)
                         prod1 = a;
-                    else if (colorEqual(c, g) && colorEqual(c, d) && !colorEqual(a, h) && colorEqual(a, i))
+                    else if (c == g && c == d && a != h && a == i)
                         prod1 = c;
                     else
-                        prod1 = colorAverage(a, c);
+                        prod1 = scaleAverage2(a, c);
 
-                    prod2.r = (a.r + b.r + c.r + d.r) >> 2;
-                    prod2.g = (a.g + b.g + c.g + d.g) >> 2;
-                    prod2.b = (a.b + b.b + c.b + d.b) >> 2;
-                    prod2.a = 255;
+                    prod2 = scaleAverage4(a, b, c, d) | alphaMask;
                 }
 
-                dest->putPixel((x << 1), (y << 1), a.r, a.g, a.b, a.a);
-                dest->putPixel((x << 1) + 1, (y << 1), prod0.r, prod0.g, prod0.b, prod0.a);
-                dest->putPixel((x << 1), (y << 1) + 1, prod1.r, prod1.g, prod1.b, prod1.a);
-                dest->putPixel((x << 1) + 1, (y << 1) + 1, prod2.r, prod2.g, prod2.b, prod2.a);
+                dest0[x << 1] = a;
+                dest0[(x << 1) + 1] = prod0;
+                dest1[x << 1] = prod1;
+                dest1[(x << 1) + 1] = prod2;
             }
         }
     }
@@ -333,21 +644,87 @@ Image *scale2xSaI(Image *src, int scale, int N) {
     return dest;
 }
 
+/**
+ * The Scale2x rules, applied to one row of pixels.  Pixels are
+ * compared for equality only, so this works equally on RGBA pixels
+ * and on (canonical) palette indexes.
+ */
+template<class T>
+static void scaleScale2xRow(const T *above, const T *row, const T *below, T *dest0, T *dest1, T *dest2, int w, int scale) {
+    int x, xoff0, xoff1;
+    T a, b, c, d, e, f, g, h, i;
+    T e0, e1, e2, e3;
+    T e4, e5, e6, e7;
+
+    for (x = 0; x < w; x++) {
+        if (x == 0)
+            xoff0 = 0;
+        else
+            xoff0 = -1;
+        if (x == w - 1)
+            xoff1 = 0;
+        else
+            xoff1 = 1;
+
+        a = above[x + xoff0];
+        b = above[x];
+        c = above[x + xoff1];
+
+        d = row[x + xoff0];
+        e = row[x];
+        f = row[x + xoff1];
+
+        g = below[x + xoff0];
+        h = below[x];
+        i = below[x + xoff1];
+
+        // lissen diagonals (45,135,225,315)
+        // corner : if there is gradient towards a diagonal direction,
+        // take the color of surrounding points in this direction
+        e0 = d == b && b != f && d != h ? d : e;
+        e1 = b == f && b != d && f != h ? f : e;
+        e2 = d == h && d != b && h != f ? d : e;
+        e3 = h == f && d != h && b != f ? f : e;
+
+        if (scale == 2) {
+            dest0[x * 2] = e0;
+            dest0[x * 2 + 1] = e1;
+            dest1[x * 2] = e2;
+            dest1[x * 2 + 1] = e3;
+        } else if (scale == 3) {
+            // lissen eight more directions (22 or 67, 112 or 157...)
+            // middle of side : if there is a gradient towards one of these directions (middle of side direction and of direction of either diagonal around this side),
+            // take the color of surrounding points in this direction
+            e4 = e0 == c ? e0 : e1 == a ? e1 : e;
+            e5 = e2 == a ? e2 : e0 == g ? e0 : e;
+            e6 = e1 == i ? e1 : e3 == c ? e3 : e;
+            e7 = e3 == g ? e3 : e2 == i ? e2 : e;
+
+            dest0[x * 3] = e0;
+            dest0[x * 3 + 1] = e4;
+            dest0[x * 3 + 2] = e1;
+            dest1[x * 3] = e5;
+            dest1[x * 3 + 1] = e;
+            dest1[x * 3 + 2] = e6;
+            dest2[x * 3] = e2;
+            dest2[x * 3 + 1] = e7;
+            dest2[x * 3 + 2] = e3;
+        }
+    }
+}
+
 /**
  * A more sophisticated scaler that doesn't interpolate, but avoids
  * the stair step effect by detecting angles.
  */
-Image *scaleScale2x(Image *src, int scale, int n) {
-    int ii, x, y, xoff0, xoff1, yoff0, yoff1;
-    RGBA a, b, c, d, e, f, g, h, i;
-    RGBA e0, e1, e2, e3;
-    RGBA e4, e5, e6, e7;
+Image *scaleScale2x(Image *src, int scale, int n, Image::Type type) {
+    int ii, x, y, yoff0, yoff1;
     Image *dest;
 
     /* this scaler works only with images scaled by 2x or 3x */
     ASSERT(scale == 2 || scale == 3, "invalid scale: %d", scale);
 
-    dest = Image::create(src->width() * scale, src->height() * scale, src->isIndexed(), Image::HARDWARE);
+    dest = Image::create(src->width() * scale, src->height() * scale, src->isIndexed(), type);
     if (!dest)
         return NULL;
 
@@ -365,6 +742,35 @@ Image *scaleScale2x(Image *src, int scale, int n) {
      * G H I
      */
 
+    int w = src->width();
+    bool indexed = dest->isIndexed();
+    uint32_t palette[256];
+    uint8_t canonical[256];
+    vector<uint32_t> rows32;
+    vector<uint8_t> rows8;
+
+    if (indexed) {
+        /*
+         * Pixels are compared by color, not by index: map every
+         * index to the first index with the same color, which is also
+         * the one a color lookup in the destination palette yields.
+         */
+        for (x = 0; x < 256; x++) {
+            canonical[x] = x;
+            RGBA color = src->getPaletteColor(x);
+            for (int k = 0; k < x; k++) {
+                RGBA other = src->getPaletteColor(k);
+                if (other.r == color.r && other.g == color.g && other.b == color.b) {
+                    canonical[x] = k;
+                    break;
+                }
+            }
+        }
+        rows8.resize(w * 3);
+    }
+    else
+        rows32.resize(w * 3);
+
     for (ii = 0; ii < n; ii++) {
         for (y = (src->height() / n) * ii; y < (src->height() / n) * (ii + 1); y++) {
             if (y == 0)
@@ -376,61 +782,24 @@ Image *scaleScale2x(Image *src, int scale, int n) {
             else
                 yoff1 = 1;
 
-            for (x = 0; x < src->width(); x++) {
-                if (x == 0)
-                    xoff0 = 0;
-                else
-                    xoff0 = -1;
-                if (x == src->width() - 1)
-                    xoff1 = 0;
-                else
-                    xoff1 = 1;
-
-                src->getPixel(x + xoff0, y + yoff0, a.r, a.g, a.b, a.a);
-                src->getPixel(x, y + yoff0, b.r, b.g, b.b, b.a);
-                src->getPixel(x + xoff1, y + yoff0, c.r, c.g, c.b, c.a);
-
-                src->getPixel(x + xoff0, y, d.r, d.g, d.b, d.a);
-                src->getPixel(x, y, e.r, e.g, e.b, e.a);
-                src->getPixel(x + xoff1, y, f.r, f.g, f.b, f.a);
-
-                src->getPixel(x + xoff0, y + yoff1, g.r, g.g, g.b, g.a);
-                src->getPixel(x, y + yoff1, h.r, h.g, h.b, h.a);
-                src->getPixel(x + xoff1, y + yoff1, i.r, i.g, i.b, i.a);
-
-                // lissen diagonals (45,135,225,315)
-                // corner : if there is gradient towards a diagonal direction,
-                // take the color of surrounding points in this direction
-                e0 = colorEqual(d, b) && (!colorEqual(b, f)) && (!colorEqual(d, h)) ? d : e;
-                e1 = colorEqual(b, f) && (!colorEqual(b, d)) && (!colorEqual(f, h)) ? f : e;
-                e2 = colorEqual(d, h) && (!colorEqual(d, b)) && (!colorEqual(h, f)) ? d : e;
-                e3 = colorEqual(h, f) && (!colorEqual(d, h)) && (!colorEqual(b, f)) ? f : e;
-
-                // lissen eight more directions (22 or 67, 112 or 157...)
-                // middle of side : if there is a gradient towards one of these directions (middle of side direction and of direction of either diagonal around this side),
-                // take the color of surrounding points in this direction
-                e4 = colorEqual(e0, c) ? e0 : colorEqual(e1, a) ? e1 : e;
-                e5 = colorEqual(e2, a) ? e2 : colorEqual(e0, g) ? e0 : e;
-                e6 = colorEqual(e1, i) ? e1 : colorEqual(e3, c) ? e3 : e;
-                e7 = colorEqual(e3, g) ? e3 : colorEqual(e2, i) ? e2 : e;
-
-                if (scale == 2) {
-                    dest->putPixel(x * 2, y * 2, e0.r, e0.g, e0.b, e0.a);
-                    dest->putPixel(x * 2 + 1, y * 2, e1.r, e1.g, e1.b, e1.a);
-                    dest->putPixel(x * 2, y * 2 + 1, e2.r, e2.g, e2.b, e2.a);
-                    dest->putPixel(x * 2 + 1, y * 2 + 1, e3.r, e3.g, e3.b, e3.a);
-                } else if (scale == 3) {
-                    dest->putPixel(x * 3, y * 3, e0.r, e0.g, e0.b, e0.a);
-                    dest->putPixel(x * 3 + 1, y * 3, e4.r, e4.g, e4.b, e4.a);
-                    dest->putPixel(x * 3 + 2, y * 3, e1.r, e1.g, e1.b, e1.a);
-                    dest->putPixel(x * 3, y * 3 + 1, e5.r, e5.g, e5.b, e5.a);
-                    dest->putPixel(x * 3 + 1, y * 3 + 1, e.r, e.g, e.b, e.a);
-                    dest->putPixel(x * 3 + 2, y * 3 + 1, e6.r, e6.g, e6.b, e6.a);
-                    dest->putPixel(x * 3, y * 3 + 2, e2.r, e2.g, e2.b, e2.a);
-                    dest->putPixel(x * 3 + 1, y * 3 + 2, e7.r, e7.g, e7.b, e7.a);
-                    dest->putPixel(x * 3 + 2, y * 3 + 2, e3.r, e3.g, e3.b, e3.a);
+            int destY = y * scale;
+            int last = (scale == 3) ? destY + 2 : destY + 1;
 
+            if (indexed) {
+                for (int r = 0; r < 3; r++) {
+                    const uint8_t *srcRow = src->getRow8(y + (r == 0 ? yoff0 : (r == 1 ? 0 : yoff1)));
+                    for (x = 0; x < w; x++)
+                        rows8[r * w + x] = canonical[srcRow[x]];
                 }
+                scaleScale2xRow(&rows8[0], &rows8[w], &rows8[w * 2],
+                                dest->getRow8(destY), dest->getRow8(destY + 1), dest->getRow8(last), w, scale);
+            }
+            else {
+                scaleFetchRow(src, y + yoff0, palette, &rows32[0]);
+                scaleFetchRow(src, y, palette, &rows32[w]);
+                scaleFetchRow(src, y + yoff1, palette, &rows32[w * 2]);
+                scaleScale2xRow(&rows32[0], &rows32[w], &rows32[w * 2],
+                                dest->getRow32(destY), dest->getRow32(destY + 1), dest->getRow32(last), w, scale);
             }
         }
     }
@@ -7,11 +7,10 @@
 
 #include <string>
 
+#include "image.h"
 #include "settings.h"
 
-class Image;
-
-typedef Image *(*Scaler)(Image *src, int scale, int n);
+typedef Image *(*Scaler)(Image *src, int scale, int n, Image::Type type);
 
 Scaler scalerGet(const std::string &filter);
 int scaler3x(const std::string &filter);
@@ -21,12 +21,16 @@
 #include "intro.h"
 #include "imagemgr.h"
 #include "location.h"
+#include "los.h"
 #include "names.h"
 #include "object.h"
 #include "player.h"
+#include "profiler.h"
 #include "savegame.h"
 #include "settings.h"
 #include "textcolor.h"
+#include "textlayout.h"
+#include "textview.h"
 #include "tileanim.h"
 #include "tileset.h"
 #include "tileview.h"
@@ -73,9 +77,7 @@ TileAnimSet *tileanims = NULL;
 ImageInfo *charsetInfo = NULL;
 ImageInfo *gemTilesInfo = NULL;
 
-void screenFindLineOfSight(vector<MapTile> viewportTiles[VIEWPORT_W][VIEWPORT_H]);
-void screenFindLineOfSightDOS(vector<MapTile> viewportTiles[VIEWPORT_W][VIEWPORT_H]);
-void screenFindLineOfSightEnhanced(vector<MapTile> viewportTiles[VIEWPORT_W][VIEWPORT_H]);
+void screenFindLineOfSight(TileStack viewportTiles[VIEWPORT_W][VIEWPORT_H]);
 
 int screenNeedPrompt = 1;
 int screenCurrentCycle = 0;
@@ -85,6 +87,33 @@ int screenCursorStatus = 0;
 int screenCursorEnabled = 1;
 int screenLos[VIEWPORT_W][VIEWPORT_H];
 
+/*
+ * What screenUpdate() last drew in the map area.  If the next update
+ * shows the same map from no more than a tile away, the map area is
+ * scrolled into place and only the cells that differ are drawn again.
+ * Anything else drawn over the map area in between makes it useless;
+ * see screenMapAreaDrawn().
+ */
+static bool screenMapAreaValid = false;
+static bool screenMapAreaUpdating = false;
+static TileView *screenMapAreaView = NULL;
+static Map *screenMapAreaMap = NULL;
+static MapCoords screenMapAreaCenter;
+static unsigned int screenMapAreaScale = 0;
+
+/*
+ * What screenMessage() has drawn in the message area, so the area can
+ * be drawn again after the screen has been wiped.  The lines form a
+ * ring: scrolling only moves screenMessageTop on to the next line.
+ */
+struct MessageCell {
+    int ch;         /**< the character drawn, or 0 if there is none */
+    int color;      /**< the text color it was drawn in, or 0 for the charset's own */
+};
+static MessageCell screenMessageCells[TEXT_AREA_H][TEXT_AREA_W];
+static int screenMessageTop = 0;   /**< the ring line shown at the top of the message area */
+static int screenTextColorCode = 0;/**< the color last set with screenTextColor(), or 0 if none */
+
 static const int BufferSize = 1024;
 
 extern bool verbose;
@@ -106,6 +135,7 @@ void screenInit() {
     
     charsetInfo = NULL;    
     gemTilesInfo = NULL;
+    screenMapAreaValid = false;
     
     screenLoadGraphicsFromConf();
     
@@ -172,6 +202,11 @@ void screenDelete() {
 void screenReInit() {        
     intro->deleteIntro();       /* delete intro stuff */
     Tileset::unloadAllImages(); /* unload tilesets, which will be reloaded lazily as needed */
+    if (DungeonView::instance)
+        DungeonView::instance->clearCaches(); /* drop dungeon views drawn with the old images */
+    for (std::vector<TileAnimSet *>::const_iterator i = tileanimSets.begin(); i != tileanimSets.end(); i++)
+        (*i)->flushFrames();    /* drop animation frames baked from the old images */
+    TextView::flushGlyphs();    /* drop the fonts drawn from the old charset */
     ImageMgr::destroy();
     tileanims = NULL;
     screenDelete(); /* delete screen stuff */
@@ -200,88 +235,70 @@ void screenPrompt() {
 }
 
 void screenMessage(const char *fmt, ...) {
-#ifdef IOS
-    static bool recursed = false;
-#endif
-    
+    /* kept between calls so its buffers don't have to be reallocated */
+    static TextLayout layout(TEXT_AREA_W, TEXT_AREA_H);
+
     if (!c)
     	return; //Because some cases (like the intro) don't have the context initiated.
     char buffer[BufferSize];
-    unsigned int i;
-    int wordlen;    
 
     va_list args;
     va_start(args, fmt);
     vsnprintf(buffer, BufferSize, fmt, args);
     va_end(args);
 #ifdef IOS
-    if (recursed)
-        recursed = false;
-    else
-        U4IOS::drawMessageOnLabel(string(buffer, 1024));
+    U4IOS::drawMessageOnLabel(string(buffer, 1024));
 #endif
 
     screenHideCursor();
 
-    /* scroll the message area, if necessary */
-    if (c->line == 12) {
-        screenScrollMessageArea();
-        c->line--;
-    }
+    layout.layout(buffer, c->col, c->line);
 
-    for (i = 0; i < strlen(buffer); i++) {
-        // include whitespace and color-change codes
-        wordlen = strcspn(buffer + i, " \b\t\n\024\025\026\027\030\031");
-
-        /* backspace */
-        if (buffer[i] == '\b') {
-            c->col--;
-            if (c->col < 0) {
-                c->col += 16;
-                c->line--;
+    /*
+     * scroll the message area once for the whole message; text laid
+     * out before a scroll is then drawn where that scroll would have
+     * moved it to, or not at all if it would have gone off the top
+     */
+    const vector<TextLayoutOp> &ops = layout.getOps();
+    vector<TextLayoutOp>::const_iterator i;
+    int scrolls = 0;
+    for (i = ops.begin(); i != ops.end(); i++) {
+        if (i->type == TextLayoutOp::SCROLL)
+            scrolls++;
+    }
+    if (scrolls > 0)
+        screenScrollMessageArea(scrolls);
+
+    for (i = ops.begin(); i != ops.end(); i++) {
+        switch (i->type) {
+        case TextLayoutOp::DRAW_CHAR:
+            {
+                int line = i->line;
+                if (line >= 0) {
+                    line -= scrolls;
+                    if (line < 0)
+                        break;
+                }
+                screenShowChar(i->ch, TEXT_AREA_X + i->col, TEXT_AREA_Y + line);
+                if (line >= 0 && line < TEXT_AREA_H && i->col >= 0 && i->col < TEXT_AREA_W) {
+                    MessageCell &cell = screenMessageCells[(screenMessageTop + line) % TEXT_AREA_H][i->col];
+                    cell.ch = i->ch;
+                    cell.color = screenTextColorCode;
+                }
             }
-            continue;
-        }
-
-		/* color-change codes */
-		switch (buffer[i])
-		{
-			case FG_GREY:
-			case FG_BLUE:
-            case FG_PURPLE:
-			case FG_GREEN:
-			case FG_RED:
-			case FG_YELLOW:
-			case FG_WHITE:
-				screenTextColor(buffer[i]);
-				continue;
-		}
-
-        /* check for word wrap */
-        if ((c->col + wordlen > 16) || buffer[i] == '\n' || c->col == 16) {
-            if (buffer[i] == '\n' || buffer[i] == ' ')
-                i++;
-            c->line++;
-            c->col = 0;
-#ifdef IOS
-            recursed = true;
-#endif
-            screenMessage("%s", buffer + i);
-            return;
-        }
-
-        /* code for move cursor right */
-        if (buffer[i] == 0x12) {
-            c->col++;
-            continue;
+            break;
+        case TextLayoutOp::SET_COLOR:
+            screenTextColor(i->ch);
+            break;
+        case TextLayoutOp::SCROLL:
+            scrolls--;
+            break;
         }
-        /* don't show a space in column 1.  Helps with Hawkwind. */
-        if (buffer[i] == ' ' && c->col == 0)
-          continue; 
-        screenShowChar(buffer[i], TEXT_AREA_X + c->col, TEXT_AREA_Y + c->line);
-        c->col++;
     }
 
+    c->col = layout.getCol();
+    c->line = layout.getLine();
+
     screenSetCursorPos(TEXT_AREA_X + c->col, TEXT_AREA_Y + c->line);
     screenShowCursor();
 
@@ -363,17 +380,26 @@ Layout *screenLoadLayoutFromConf(const ConfigElement &conf) {
 
 
 
-vector<MapTile> screenViewportTile(unsigned int width, unsigned int height, int x, int y, bool &focus) {
-    MapCoords center = c->location->coords;    
-    static MapTile grass = c->location->map->tileset->getByName("grass")->getId();
-    
+/**
+ * Returns the map location shown in the center of a viewport of the
+ * given size.  Maps that fit in the viewport entirely are centered.
+ */
+static MapCoords screenViewportCenter(unsigned int width, unsigned int height) {
+    MapCoords center = c->location->coords;
+
     if (c->location->map->width <= width &&
         c->location->map->height <= height) {
         center.x = c->location->map->width / 2;
         center.y = c->location->map->height / 2;
     }
 
-    MapCoords tc = center;
+    return center;
+}
+
+void screenViewportTile(unsigned int width, unsigned int height, int x, int y, bool &focus, TileStack &tiles) {
+    static MapTile grass = c->location->map->tileset->getByName("grass")->getId();
+
+    MapCoords tc = screenViewportCenter(width, height);
 
     tc.x += x - (width / 2);
     tc.y += y - (height / 2);
@@ -384,12 +410,12 @@ vector<MapTile> screenViewportTile(unsigned int width, unsigned int height, int
     /* off the edge of the map: pad with grass tiles */
     if (MAP_IS_OOB(c->location->map, tc)) {        
         focus = false;
-        vector<MapTile> result;
-        result.push_back(grass);
-        return result;
+        tiles.clear();
+        tiles.push_back(grass);
+        return;
     }
 
-    return c->location->tilesAt(tc, focus);
+    c->location->tilesAt(tc, focus, tiles);
 }
 
 bool screenTileUpdate(TileView *view, const Coords &coords, bool redraw)
@@ -401,7 +427,8 @@ bool screenTileUpdate(TileView *view, const Coords &coords, bool redraw)
 	bool focus;
 	MapCoords mc(coords);
 	mc.wrap(c->location->map);
-	vector<MapTile> tiles = c->location->tilesAt(mc, focus);
+	TileStack tiles;
+	c->location->tilesAt(mc, focus, tiles);
 
 	// Get the screen coordinates
 	int x = coords.x;
@@ -428,12 +455,61 @@ bool screenTileUpdate(TileView *view, const Coords &coords, bool redraw)
 	return false;
 }
 
+/**
+ * Returns true if cell (x, y) of the current viewport can keep what
+ * cell (ox, oy) of the last viewport showed: the same tiles, the same
+ * line of sight, no focus rectangle and nothing animated.
+ */
+static bool screenSameCell(int current, int x, int y, int ox, int oy,
+                           TileStack tiles[2][VIEWPORT_W][VIEWPORT_H],
+                           bool focus[2][VIEWPORT_W][VIEWPORT_H],
+                           int los[2][VIEWPORT_W][VIEWPORT_H]) {
+    int last = current ^ 1;
+
+    if (ox < 0 || oy < 0 || ox >= VIEWPORT_W || oy >= VIEWPORT_H)
+        return false;
+    if (los[current][x][y] != los[last][ox][oy])
+        return false;
+    if (!los[current][x][y])
+        return true;
+    if (focus[current][x][y] || focus[last][ox][oy])
+        return false;
+
+    const TileStack &a = tiles[current][x][y];
+    const TileStack &b = tiles[last][ox][oy];
+    if (a.size() != b.size())
+        return false;
+    for (unsigned int i = 0; i < a.size(); i++) {
+        if (a[i].id != b[i].id || a[i].frame != b[i].frame)
+            return false;
+        Tile *tile = Tileset::findTileById(a[i].id);
+        if (!tile || tile->getAnim())
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Lets the map area know that something was drawn on the screen.  If
+ * it came from anywhere but screenUpdate() and covers the map area,
+ * the next update has to draw the whole map area again.
+ */
+void screenMapAreaDrawn(int x, int y, int width, int height) {
+    if (screenMapAreaUpdating || !screenMapAreaValid)
+        return;
+
+    if (x < int(SCALED(BORDER_WIDTH + VIEWPORT_W * TILE_WIDTH)) && x + width > int(SCALED(BORDER_WIDTH)) &&
+        y < int(SCALED(BORDER_HEIGHT + VIEWPORT_H * TILE_HEIGHT)) && y + height > int(SCALED(BORDER_HEIGHT)))
+        screenMapAreaValid = false;
+}
+
 /**
  * Redraw the screen.  If showmap is set, the normal map is drawn in
  * the map area.  If blackout is set, the map area is blacked out. If
  * neither is set, the map area is left untouched.
  */
 void screenUpdate(TileView *view, bool showmap, bool blackout) {
+    PROFILE_ZONE("screenUpdate()");
     ASSERT(c != NULL, "context has not yet been initialized");
 
     screenLock();
@@ -453,26 +529,70 @@ void screenUpdate(TileView *view, bool showmap, bool blackout) {
 
         int x, y;
 
-        vector<MapTile> viewportTiles[VIEWPORT_W][VIEWPORT_H];
-        bool viewportFocus[VIEWPORT_W][VIEWPORT_H];
+        /*
+         * this frame's viewport and the last one, kept from frame to
+         * frame so the tile stacks can reuse their storage
+         */
+        static TileStack viewportTiles[2][VIEWPORT_W][VIEWPORT_H];
+        static bool viewportFocus[2][VIEWPORT_W][VIEWPORT_H];
+        static int viewportLos[2][VIEWPORT_W][VIEWPORT_H];
+        static int current = 0;
+
+        current ^= 1;
+        TileStack (*tiles)[VIEWPORT_H] = viewportTiles[current];
+        bool (*focus)[VIEWPORT_H] = viewportFocus[current];
 
         for (y = 0; y < VIEWPORT_H; y++) {
             for (x = 0; x < VIEWPORT_W; x++) {
-                viewportTiles[x][y] = screenViewportTile(VIEWPORT_W, VIEWPORT_H, x, y, viewportFocus[x][y]);
+                screenViewportTile(VIEWPORT_W, VIEWPORT_H, x, y, focus[x][y], tiles[x][y]);
             }
         }
 
-		screenFindLineOfSight(viewportTiles);
+		screenFindLineOfSight(tiles);
+        memcpy(viewportLos[current], screenLos, sizeof(screenLos));
+
+        /* see how far the view has moved since it was last drawn */
+        MapCoords center = screenViewportCenter(VIEWPORT_W, VIEWPORT_H);
+        int dx = center.x - screenMapAreaCenter.x;
+        int dy = center.y - screenMapAreaCenter.y;
+        if (c->location->map->border_behavior == Map::BORDER_WRAP) {
+            int w = c->location->map->width, h = c->location->map->height;
+            dx = ((dx % w) + w + w / 2) % w - w / 2;
+            dy = ((dy % h) + h + h / 2) % h - h / 2;
+        }
+
+        bool reuse = screenMapAreaValid &&
+            screenMapAreaView == view &&
+            screenMapAreaMap == c->location->map &&
+            screenMapAreaScale == settings.scale &&
+            center.z == screenMapAreaCenter.z &&
+            abs(dx) <= 1 && abs(dy) <= 1;
+
+        screenMapAreaUpdating = true;
+        if (reuse)
+            view->scroll(dx, dy);
 
         for (y = 0; y < VIEWPORT_H; y++) {
             for (x = 0; x < VIEWPORT_W; x++) {
+                /* the cell shows just what it did before, from where it has been scrolled */
+                if (reuse && screenSameCell(current, x, y, x + dx, y + dy, viewportTiles, viewportFocus, viewportLos))
+                    continue;
+
                 if (screenLos[x][y]) {
-               		view->drawTile(viewportTiles[x][y], viewportFocus[x][y], x, y);
+               		view->drawTile(tiles[x][y], focus[x][y], x, y);
                 }
                 else
                     view->drawTile(black, false, x, y);
             }
         }
+        screenMapAreaUpdating = false;
+
+        screenMapAreaValid = true;
+        screenMapAreaView = view;
+        screenMapAreaMap = c->location->map;
+        screenMapAreaCenter = center;
+        screenMapAreaScale = settings.scale;
+
         screenRedrawMapArea();
     }
 
@@ -548,7 +668,8 @@ void screenTextColor(int color) {
 		case FG_RED:
 		case FG_YELLOW:
 		case FG_WHITE:
-			charsetInfo->image->setFontColorFG((ColorFG)color);
+			TextView::setFontColorFG((ColorFG)color);
+			screenTextColorCode = color;
 	}
 }
 
@@ -562,37 +683,81 @@ void screenShowChar(int chr, int x, int y) {
             errorFatal("ERROR 1001: Unable to load the \"%s\" data file.\t\n\nIs %s installed?\n\nVisit the XU4 website for additional information.\n\thttp://xu4.sourceforge.net/", BKGD_CHARSET, settings.game.c_str());
     }
     
-    charsetInfo->image->drawSubRect(x * charsetInfo->image->width(), y * (CHAR_HEIGHT * settings.scale),
-                                    0, chr * (CHAR_HEIGHT * settings.scale),
-                                    charsetInfo->image->width(), CHAR_HEIGHT * settings.scale);
+    TextView::getGlyphs()->drawSubRect(x * charsetInfo->image->width(), y * (CHAR_HEIGHT * settings.scale),
+                                       0, chr * (CHAR_HEIGHT * settings.scale),
+                                       charsetInfo->image->width(), CHAR_HEIGHT * settings.scale);
 }
 
 /**
- * Scroll the text in the message area up one position.
+ * Scroll the text in the message area up the given number of lines
+ * with a single copy.
  */
-void screenScrollMessageArea() {
-    ASSERT(charsetInfo != NULL && charsetInfo->image != NULL, "charset not initialized!");
-    
+void screenScrollMessageArea(int lines) {
     Image *screen = imageMgr->get("screen")->image;
     
-    screen->drawSubRectOn(screen, 
-                          TEXT_AREA_X * charsetInfo->image->width(), 
-                          TEXT_AREA_Y * CHAR_HEIGHT * settings.scale,
-                          TEXT_AREA_X * charsetInfo->image->width(),
-                          (TEXT_AREA_Y + 1) * CHAR_HEIGHT * settings.scale,
-                          TEXT_AREA_W * charsetInfo->image->width(),
-                          (TEXT_AREA_H - 1) * CHAR_HEIGHT * settings.scale);
+    if (lines > TEXT_AREA_H)
+        lines = TEXT_AREA_H;
+
+    if (lines < TEXT_AREA_H)
+        screen->drawSubRectOn(screen, 
+                              TEXT_AREA_X * CHAR_WIDTH * settings.scale, 
+                              TEXT_AREA_Y * CHAR_HEIGHT * settings.scale,
+                              TEXT_AREA_X * CHAR_WIDTH * settings.scale,
+                              (TEXT_AREA_Y + lines) * CHAR_HEIGHT * settings.scale,
+                              TEXT_AREA_W * CHAR_WIDTH * settings.scale,
+                              (TEXT_AREA_H - lines) * CHAR_HEIGHT * settings.scale);
     
     
-    screen->fillRect(TEXT_AREA_X * charsetInfo->image->width(),
-                     TEXT_AREA_Y * CHAR_HEIGHT * settings.scale + (TEXT_AREA_H - 1) * CHAR_HEIGHT * settings.scale,
-                     TEXT_AREA_W * charsetInfo->image->width(),
-                     CHAR_HEIGHT * settings.scale,
+    screen->fillRect(TEXT_AREA_X * CHAR_WIDTH * settings.scale,
+                     (TEXT_AREA_Y + TEXT_AREA_H - lines) * CHAR_HEIGHT * settings.scale,
+                     TEXT_AREA_W * CHAR_WIDTH * settings.scale,
+                     lines * CHAR_HEIGHT * settings.scale,
                      0, 0, 0);
+
+    /* the lines that went off the top come back in at the bottom, empty */
+    for (int y = 0; y < lines; y++) {
+        MessageCell *row = screenMessageCells[(screenMessageTop + y) % TEXT_AREA_H];
+        for (int x = 0; x < TEXT_AREA_W; x++)
+            row[x].ch = 0;
+    }
+    screenMessageTop = (screenMessageTop + lines) % TEXT_AREA_H;
     
     screenRedrawScreen();
 }
 
+/**
+ * Draws what screenMessage() has put in the message area again, e.g.
+ * after returning to the game from the main menu.
+ */
+void screenRedrawMessageArea() {
+    int color = screenTextColorCode;
+
+    screenEraseTextArea(TEXT_AREA_X, TEXT_AREA_Y, TEXT_AREA_W, TEXT_AREA_H);
+    for (int y = 0; y < TEXT_AREA_H; y++) {
+        const MessageCell *row = screenMessageCells[(screenMessageTop + y) % TEXT_AREA_H];
+        for (int x = 0; x < TEXT_AREA_W; x++) {
+            if (row[x].ch == 0)
+                continue;
+            if (row[x].color != 0 && row[x].color != screenTextColorCode)
+                screenTextColor(row[x].color);
+            screenShowChar(row[x].ch, TEXT_AREA_X + x, TEXT_AREA_Y + y);
+        }
+    }
+    if (color != screenTextColorCode)
+        screenTextColor(color);
+}
+
+/**
+ * Forgets what is in the message area, e.g. when a new game starts.
+ */
+void screenClearMessageArea() {
+    for (int y = 0; y < TEXT_AREA_H; y++) {
+        for (int x = 0; x < TEXT_AREA_W; x++)
+            screenMessageCells[y][x].ch = 0;
+    }
+    screenMessageTop = 0;
+}
+
 void screenCycle() {
     if (++screenCurrentCycle >= SCR_CYCLE_MAX)
         screenCurrentCycle = 0;
@@ -680,9 +845,9 @@ void screenSetCursorPos(int x, int y) {
 
 /**
  * Finds which tiles in the viewport are visible from the avatars
- * location in the middle. (original DOS algorithm)
+ * location in the middle.
  */
-void screenFindLineOfSight(vector <MapTile> viewportTiles[VIEWPORT_W][VIEWPORT_H]) {
+void screenFindLineOfSight(TileStack viewportTiles[VIEWPORT_W][VIEWPORT_H]) {
     int x, y;
 
     if (!c)
@@ -701,308 +866,30 @@ void screenFindLineOfSight(vector <MapTile> viewportTiles[VIEWPORT_W][VIEWPORT_H
     }
 
     /*
-     * otherwise calculate it from the map data
+     * otherwise calculate it from the opacity of the viewport tiles
      */
+    LosMask opaque, visible;
     for (y = 0; y < VIEWPORT_H; y++) {
+        opaque[y] = 0;
         for (x = 0; x < VIEWPORT_W; x++) {
-            screenLos[x][y] = 0;
+            if (viewportTiles[x][y].front().getTileType()->isOpaque())
+                opaque[y] |= 1 << x;
         }
     }
 
     if (settings.lineOfSight == "DOS")
-        screenFindLineOfSightDOS(viewportTiles);
+        losFindDOS(opaque, visible);
     else if (settings.lineOfSight == "Enhanced")
-        screenFindLineOfSightEnhanced(viewportTiles);
+        losFindEnhanced(opaque, visible);
     else
         errorFatal("unknown line of sight style %s!\n", settings.lineOfSight.c_str());
-}        
-
-
-/**
- * Finds which tiles in the viewport are visible from the avatars
- * location in the middle. (original DOS algorithm)
- */
-void screenFindLineOfSightDOS(vector <MapTile> viewportTiles[VIEWPORT_W][VIEWPORT_H]) {
-    int x, y;
-
-    screenLos[VIEWPORT_W / 2][VIEWPORT_H / 2] = 1;
-
-    for (x = VIEWPORT_W / 2 - 1; x >= 0; x--)
-        if (screenLos[x + 1][VIEWPORT_H / 2] &&
-            !viewportTiles[x + 1][VIEWPORT_H / 2].front().getTileType()->isOpaque())
-            screenLos[x][VIEWPORT_H / 2] = 1;
-
-    for (x = VIEWPORT_W / 2 + 1; x < VIEWPORT_W; x++)
-        if (screenLos[x - 1][VIEWPORT_H / 2] &&
-            !viewportTiles[x - 1][VIEWPORT_H / 2].front().getTileType()->isOpaque())
-            screenLos[x][VIEWPORT_H / 2] = 1;
 
-    for (y = VIEWPORT_H / 2 - 1; y >= 0; y--)
-        if (screenLos[VIEWPORT_W / 2][y + 1] &&
-            !viewportTiles[VIEWPORT_W / 2][y + 1].front().getTileType()->isOpaque())
-            screenLos[VIEWPORT_W / 2][y] = 1;
-
-    for (y = VIEWPORT_H / 2 + 1; y < VIEWPORT_H; y++)
-        if (screenLos[VIEWPORT_W / 2][y - 1] &&
-            !viewportTiles[VIEWPORT_W / 2][y - 1].front().getTileType()->isOpaque())
-            screenLos[VIEWPORT_W / 2][y] = 1;
-
-    for (y = VIEWPORT_H / 2 - 1; y >= 0; y--) {
-        
-        for (x = VIEWPORT_W / 2 - 1; x >= 0; x--) {
-            if (screenLos[x][y + 1] &&
-                !viewportTiles[x][y + 1].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-            else if (screenLos[x + 1][y] &&
-                     !viewportTiles[x + 1][y].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-            else if (screenLos[x + 1][y + 1] &&
-                     !viewportTiles[x + 1][y + 1].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-        }
-                
-        for (x = VIEWPORT_W / 2 + 1; x < VIEWPORT_W; x++) {
-            if (screenLos[x][y + 1] &&
-                !viewportTiles[x][y + 1].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-            else if (screenLos[x - 1][y] &&
-                     !viewportTiles[x - 1][y].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-            else if (screenLos[x - 1][y + 1] &&
-                     !viewportTiles[x - 1][y + 1].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-        }
-    }
-
-    for (y = VIEWPORT_H / 2 + 1; y < VIEWPORT_H; y++) {
-        
-        for (x = VIEWPORT_W / 2 - 1; x >= 0; x--) {
-            if (screenLos[x][y - 1] &&
-                !viewportTiles[x][y - 1].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-            else if (screenLos[x + 1][y] &&
-                     !viewportTiles[x + 1][y].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-            else if (screenLos[x + 1][y - 1] &&
-                     !viewportTiles[x + 1][y - 1].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-        }
-                
-        for (x = VIEWPORT_W / 2 + 1; x < VIEWPORT_W; x++) {
-            if (screenLos[x][y - 1] &&
-                !viewportTiles[x][y - 1].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-            else if (screenLos[x - 1][y] &&
-                     !viewportTiles[x - 1][y].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-            else if (screenLos[x - 1][y - 1] &&
-                     !viewportTiles[x - 1][y - 1].front().getTileType()->isOpaque())
-                screenLos[x][y] = 1;
-        }
-    }
-}
-
-/**
- * Finds which tiles in the viewport are visible from the avatars
- * location in the middle.
- *
- * A new, more accurate LOS function
- *
- * Based somewhat off Andy McFadden's 1994 article,
- *   "Improvements to a Fast Algorithm for Calculating Shading
- *   and Visibility in a Two-Dimensional Field"
- *   -----
- *   http://www.fadden.com/techmisc/fast-los.html
- *
- * This function uses a lookup table to get the correct shadowmap,
- * therefore, the table will need to be updated if the viewport
- * dimensions increase. Also, the function assumes that the
- * viewport width and height are odd values and that the player
- * is always at the center of the screen.
- */
-void screenFindLineOfSightEnhanced(vector <MapTile> viewportTiles[VIEWPORT_W][VIEWPORT_H]) {
-    int x, y;
-
-    /*
-     * the shadow rasters for each viewport octant
-     *
-     * shadowRaster[0][0]    // number of raster segments in this shadow
-     * shadowRaster[0][1]    // #1 shadow bitmask value (low three bits) + "newline" flag (high bit)
-     * shadowRaster[0][2]    // #1 length
-     * shadowRaster[0][3]    // #2 shadow bitmask value
-     * shadowRaster[0][4]    // #2 length
-     * shadowRaster[0][5]    // #3 shadow bitmask value
-     * shadowRaster[0][6]    // #3 length
-     * ...etc...
-     */
-    const int shadowRaster[14][13] = {
-        { 6, __VCH, 4, _N_CH, 1, __VCH, 3, _N___, 1, ___CH, 1, __VCH, 1 },    // raster_1_0
-        { 6, __VC_, 1, _NVCH, 2, __VC_, 1, _NVCH, 3, _NVCH, 2, _NVCH, 1 },    // raster_1_1
-        //
-        { 4, __VCH, 3, _N__H, 1, ___CH, 1, __VCH, 1,     0, 0,     0, 0 },    // raster_2_0
-        { 6, __VC_, 2, _N_CH, 1, __VCH, 2, _N_CH, 1, __VCH, 1, _N__H, 1 },    // raster_2_1
-        { 6, __V__, 1, _NVCH, 1, __VC_, 1, _NVCH, 1, __VC_, 1, _NVCH, 1 },    // raster_2_2
-        //
-        { 2, __VCH, 2, _N__H, 2,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_3_0
-        { 3, __VC_, 2, _N_CH, 1, __VCH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_1
-        { 3, __VC_, 1, _NVCH, 2, _N_CH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_2
-        { 3, _NVCH, 1, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0 },    // raster_3_3
-        //
-        { 2, __VCH, 1, _N__H, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_0
-        { 2, __VC_, 1, _N__H, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_1
-        { 2, __VC_, 1, _N_CH, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_2
-        { 2, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0,     0, 0 },    // raster_4_3
-        { 2, __V__, 1, _NVCH, 1,     0, 0,     0, 0,     0, 0,     0, 0 }     // raster_4_4
-    };
-
-    /*
-     * As each viewport tile is processed, it will store the bitmask for the shadow it casts.
-     * Later, after processing all octants, the entire viewport will be marked visible except
-     * for those tiles that have the __VCH bitmask.
-     */
-    const int _OCTANTS = 8;
-    const int _NUM_RASTERS_COLS = 4;
-    
-    int octant;
-    int xOrigin, yOrigin, xSign, ySign, reflect, xTile, yTile, xTileOffset, yTileOffset;
-
-    for (octant = 0; octant < _OCTANTS; octant++) {
-        switch (octant) {
-            case 0:  xSign=  1;  ySign=  1;  reflect=false;  break;        // lower-right
-            case 1:  xSign=  1;  ySign=  1;  reflect=true;   break;
-            case 2:  xSign=  1;  ySign= -1;  reflect=true;   break;        // lower-left
-            case 3:  xSign= -1;  ySign=  1;  reflect=false;  break;
-            case 4:  xSign= -1;  ySign= -1;  reflect=false;  break;        // upper-left
-            case 5:  xSign= -1;  ySign= -1;  reflect=true;   break;
-            case 6:  xSign= -1;  ySign=  1;  reflect=true;   break;        // upper-right
-            case 7:  xSign=  1;  ySign= -1;  reflect=false;  break;
-        }
-
-        // determine the origin point for the current LOS octant
-        xOrigin = VIEWPORT_W / 2;
-        yOrigin = VIEWPORT_H / 2;
-
-        // make sure the segment doesn't reach out of bounds
-        int maxWidth      = xOrigin;
-        int maxHeight     = yOrigin;
-        int currentRaster = 0;
-
-        // just in case the viewport isn't square, swap the width and height
-        if (reflect) {
-            // swap height and width for later use
-            maxWidth ^= maxHeight;
-            maxHeight ^= maxWidth;
-            maxWidth ^= maxHeight;
-        }
-
-        // check the visibility of each tile
-        for (int currentCol = 1; currentCol <= _NUM_RASTERS_COLS; currentCol++) {
-            for (int currentRow = 0; currentRow <= currentCol; currentRow++) {
-                // swap X and Y to reflect the octant rasters
-                if (reflect) {
-                    xTile = xOrigin+(currentRow*ySign);
-                    yTile = yOrigin+(currentCol*xSign);
-                }
-                else {
-                    xTile = xOrigin+(currentCol*xSign);
-                    yTile = yOrigin+(currentRow*ySign);
-                }
-
-                if (viewportTiles[xTile][yTile].front().getTileType()->isOpaque()) {
-                    // a wall was detected, so go through the raster for this wall
-                    // segment and mark everything behind it with the appropriate
-                    // shadow bitmask.
-                    //
-                    // first, get the correct raster
-                    //
-                    if ((currentCol==1) && (currentRow==0)) { currentRaster=0; }
-                    else if ((currentCol==1) && (currentRow==1)) { currentRaster=1; }
-                    else if ((currentCol==2) && (currentRow==0)) { currentRaster=2; }
-                    else if ((currentCol==2) && (currentRow==1)) { currentRaster=3; }
-                    else if ((currentCol==2) && (currentRow==2)) { currentRaster=4; }
-                    else if ((currentCol==3) && (currentRow==0)) { currentRaster=5; }
-                    else if ((currentCol==3) && (currentRow==1)) { currentRaster=6; }
-                    else if ((currentCol==3) && (currentRow==2)) { currentRaster=7; }
-                    else if ((currentCol==3) && (currentRow==3)) { currentRaster=8; }
-                    else if ((currentCol==4) && (currentRow==0)) { currentRaster=9; }
-                    else if ((currentCol==4) && (currentRow==1)) { currentRaster=10; }
-                    else if ((currentCol==4) && (currentRow==2)) { currentRaster=11; }
-                    else if ((currentCol==4) && (currentRow==3)) { currentRaster=12; }
-                    else { currentRaster=13; }  // currentCol and currentRow must equal 4
-
-                    xTileOffset = 0;
-                    yTileOffset = 0;
-
-                    //========================================
-                    for (int currentSegment = 0; currentSegment < shadowRaster[currentRaster][0]; currentSegment++) {
-                        // each shadow segment is 2 bytes
-                        int shadowType   = shadowRaster[currentRaster][currentSegment*2+1];
-                        int shadowLength = shadowRaster[currentRaster][currentSegment*2+2];
-
-                        // update the raster length to make sure it fits in the viewport
-                        shadowLength = (shadowLength+1+yTileOffset > maxWidth ? maxWidth : shadowLength);
-
-                        // check to see if we should move up a row
-                        if (shadowType & 0x80) {
-                            // remove the flag from the shadowType
-                            shadowType ^= _N___;
-//                            if (currentRow + yTileOffset >= maxHeight) {
-                            if (currentRow + yTileOffset > maxHeight) {
-                                break;
-                            }
-                            xTileOffset = yTileOffset;
-                            yTileOffset++;
-                        }
-
-                        /* it is seemingly unnecessary to swap the edges for
-                         * shadow tiles, because we only care about shadow
-                         * tiles that have all three parts (V, C, and H)
-                         * flagged.  if a tile has fewer than three, it is
-                         * ignored during the draw phase, so vertical and
-                         * horizontal shadow edge accuracy isn't important
-                         */
-                        // if reflecting the octant, swap the edges
-//                        if (reflect) {
-//                            int shadowTemp = 0;
-//                            // swap the vertical and horizontal shadow edges
-//                            if (shadowType & __V__) { shadowTemp |= ____H; }
-//                            if (shadowType & ___C_) { shadowTemp |= ___C_; }
-//                            if (shadowType & ____H) { shadowTemp |= __V__; }
-//                            shadowType = shadowTemp;
-//                        }
-
-                        for (int currentShadow = 1; currentShadow <= shadowLength; currentShadow++) {
-                            // apply the shadow to the shadowMap
-                            if (reflect) {
-                                screenLos[xTile + ((yTileOffset) * ySign)][yTile + ((currentShadow+xTileOffset) * xSign)] |= shadowType;
-                            }
-                            else {
-                                screenLos[xTile + ((currentShadow+xTileOffset) * xSign)][yTile + ((yTileOffset) * ySign)] |= shadowType;
-                            }
-                        }
-                        xTileOffset += shadowLength;
-                    }  // for (int currentSegment = 0; currentSegment < shadowRaster[currentRaster][0]; currentSegment++)
-                    //========================================
-
-                }  // if (viewportTiles[xTile][yTile].front().getTileType()->isOpaque())
-            }  // for (int currentRow = 0; currentRow <= currentCol; currentRow++)
-        }  // for (int currentCol = 1; currentCol <= _NUM_RASTERS_COLS; currentCol++)
-    }  // for (octant = 0; octant < _OCTANTS; octant++)
-
-    // go through all tiles on the viewable area and set the appropriate visibility
     for (y = 0; y < VIEWPORT_H; y++) {
         for (x = 0; x < VIEWPORT_W; x++) {
-            // if the shadow flags equal __VCH, hide it, otherwise it's fully visible
-            //
-            if ((screenLos[x][y] & __VCH) == __VCH) {
-                screenLos[x][y] = 0;
-            }
-            else {
-                screenLos[x][y] = 1;
-            }
+            screenLos[x][y] = (visible[y] >> x) & 1;
         }
     }
-}
+}        
 
 /**
  * Generates terms a and b for equation "ax + b = y" that defines the
@@ -1222,6 +1109,7 @@ Layout *screenGetGemLayout(const Map *map) {
 
 void screenGemUpdate() {
     MapTile tile;
+    TileStack tiles;
     int x, y;
     Image *screen = imageMgr->get("screen")->image;
     
@@ -1270,8 +1158,8 @@ void screenGemUpdate() {
     		bool focus;
             
             
-			vector<MapTile> tiles = screenViewportTile(layout->viewport.width,
-                                                       layout->viewport.height, x - center_x + avt_x, y - center_y + avt_y, focus);
+			screenViewportTile(layout->viewport.width,
+                               layout->viewport.height, x - center_x + avt_x, y - center_y + avt_y, focus, tiles);
 			tile = tiles.front();
             
 			TileId avatarTileId = c->location->map->tileset->getByName("avatar")->getId();
@@ -1313,8 +1201,9 @@ void screenGemUpdate() {
 		for (x = 0; x < layout->viewport.width; x++) {
 			for (y = 0; y < layout->viewport.height; y++) {
 				bool focus;
-				tile = screenViewportTile(layout->viewport.width,
-                                          layout->viewport.height, x, y, focus).front();
+				screenViewportTile(layout->viewport.width,
+                                   layout->viewport.height, x, y, focus, tiles);
+				tile = tiles.front();
 				screenShowGemTile(layout, c->location->map, tile, focus, x, y);
 			}
 		}
@@ -43,24 +43,6 @@ class Coords;
 #define PRINTF_LIKE(x,y)
 #endif
 
-/*
- * bitmasks for LOS shadows
- */
-#define ____H 0x01    // obscured along the horizontal face
-#define ___C_ 0x02    // obscured at the center
-#define __V__ 0x04    // obscured along the vertical face
-#define _N___ 0x80    // start of new raster
-
-#define ___CH 0x03
-#define __VCH 0x07
-#define __VC_ 0x06
-
-#define _N__H 0x81
-#define _N_CH 0x83
-#define _NVCH 0x87
-#define _NVC_ 0x86
-#define _NV__ 0x84
-
 typedef enum {
     MC_DEFAULT,
     MC_WEST,
@@ -80,6 +62,16 @@ typedef struct _MouseArea {
 
 #define SCR_CYCLE_PER_SECOND 4
 
+/**
+ * How often the screen is being pushed to the display.
+ */
+struct ScreenRefreshStats {
+    unsigned int presents;          /**< presents since startup */
+    unsigned int skippedFrames;     /**< frame periods the refresh fell behind by while damage was pending */
+    unsigned int invalidations;     /**< screenDamage() calls coalesced into those presents */
+    float presentRate;              /**< presents per second since the last query */
+};
+
 void screenInit(void);
 void screenRefreshTimerInit(void);
 void screenDelete(void);
@@ -98,16 +90,22 @@ void screenDrawImage(const std::string &name, int x = 0, int y = 0);
 void screenDrawImageInMapArea(const std::string &bkgd);
 
 void screenCycle(void);
+void screenDamage(int x, int y, int width, int height);
+void screenDamageAll(void);
+ScreenRefreshStats screenGetRefreshStats(void);
+void screenMapAreaDrawn(int x, int y, int width, int height);
 void screenEraseMapArea(void);
 void screenEraseTextArea(int x, int y, int width, int height);
+void screenClearMessageArea(void);
 void screenGemUpdate(void);
 
 void screenMessage(const char *fmt, ...) PRINTF_LIKE(1, 2);
 void screenPrompt(void);
 void screenRedrawMapArea(void);
+void screenRedrawMessageArea(void);
 void screenRedrawScreen(void);
 void screenRedrawTextArea(int x, int y, int width, int height);
-void screenScrollMessageArea(void);
+void screenScrollMessageArea(int lines = 1);
 void screenShake(int iterations);
 void screenShowChar(int chr, int x, int y);
 void screenShowCharMasked(int chr, int x, int y, unsigned char mask);
@@ -118,7 +116,7 @@ void screenUpdate(TileView *view, bool showmap, bool blackout);
 void screenUpdateCursor(void);
 void screenUpdateMoons(void);
 void screenUpdateWind(void);
-std::vector<MapTile> screenViewportTile(unsigned int width, unsigned int height, int x, int y, bool &focus);
+void screenViewportTile(unsigned int width, unsigned int height, int x, int y, bool &focus, TileStack &tiles);
 
 void screenShowCursor(void);
 void screenHideCursor(void);
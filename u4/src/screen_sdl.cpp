@@ -26,6 +26,7 @@
 #include "image.h"
 #include "imagemgr.h"
 #include "intro.h"
+#include "profiler.h"
 #include "savegame.h"
 #include "settings.h"
 #include "scale.h"
@@ -49,6 +50,7 @@ extern bool verbose;
 
 void screenRefreshThreadInit();
 void screenRefreshThreadEnd();
+Image *screenScaleWith(Image *src, int scale, int n, int filter, Scaler scaler, bool filter3x, Image::Type type);
 
 void screenInit_sys() {
     /* start SDL */
@@ -65,6 +67,7 @@ void screenInit_sys() {
 
     if (!SDL_SetVideoMode(320 * settings.scale, 200 * settings.scale, 16, SDL_SWSURFACE | SDL_ANYFORMAT | (settings.fullscreen ? SDL_FULLSCREEN : 0)))
         errorFatal("unable to set video: %s", SDL_GetError());
+    screenDamageAll();
 
     if (verbose) {
         char driver[32];
@@ -185,12 +188,16 @@ int screenLoadImageCga(Image **image, int width, int height, U4FILE *file, Compr
 
     img->setPalette(egaPalette, 16);
 
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x+=4) {
-            img->putPixelIndex(x, y, decompressed_data[(y * width + x) / 4] >> 6);
-            img->putPixelIndex(x + 1, y, (decompressed_data[(y * width + x) / 4] >> 4) & 0x03);
-            img->putPixelIndex(x + 2, y, (decompressed_data[(y * width + x) / 4] >> 2) & 0x03);
-            img->putPixelIndex(x + 3, y, (decompressed_data[(y * width + x) / 4]) & 0x03);
+    {
+        /* unpack each row of four pixels per byte, high bits first */
+        std::vector<Uint8> row(width);
+        ImageLock lock(img);
+
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++)
+                row[x] = (decompressed_data[(y * width + x - x % 4) / 4] >> ((3 - x % 4) * 2)) & 0x03;
+            if (width > 0)
+                img->putSpan(0, y, width, &row[0]);
         }
     }
     free(decompressed_data);
@@ -216,9 +223,154 @@ void screenUnlock() {
 	SDL_mutexV(screenLockMutex);
 }
 
+/*
+ * Damage tracking: the regions of the screen surface that have been
+ * drawn on since the last present.  Only these are pushed to the
+ * display by screenRedrawScreen().
+ */
+#define SCR_DAMAGE_MAX 32
+
+SDL_mutex *screenDamageMutex = NULL;
+SDL_cond *screenDamageCond = NULL;      /**< signalled when the screen goes from clean to dirty */
+SDL_Rect screenDamageRects[SCR_DAMAGE_MAX];
+int screenDamageCount = 0;
+
+/*
+ * Refresh statistics, guarded by screenDamageMutex.  A frame is
+ * counted as skipped when the refresh falls behind: each whole frame
+ * period beyond the first that goes by between the first damage after
+ * a present and the next present is one skipped frame.  Time with
+ * nothing to present isn't counted.
+ */
+unsigned int screenPresentCount = 0;
+unsigned int screenSkippedFrames = 0;
+unsigned int screenInvalidations = 0;   /**< screenDamage() calls folded into the presents so far */
+unsigned int screenPendingDamage = 0;   /**< screenDamage() calls since the last present */
+Uint32 screenFirstDamageTime = 0;       /**< when the first of those came in */
+Uint32 screenLastPresentTime = 0;
+unsigned int screenRatePresents = 0;
+Uint32 screenRateStartTime = 0;
+
+/**
+ * Returns true if the two rectangles overlap or share an edge.
+ */
+static bool screenRectsTouch(const SDL_Rect &a, const SDL_Rect &b) {
+    return a.x <= b.x + b.w && b.x <= a.x + a.w &&
+           a.y <= b.y + b.h && b.y <= a.y + a.h;
+}
+
+/**
+ * Grows rectangle a to also cover rectangle b.
+ */
+static void screenRectUnion(SDL_Rect &a, const SDL_Rect &b) {
+    int x1 = std::min(a.x, b.x);
+    int y1 = std::min(a.y, b.y);
+    int x2 = std::max(a.x + a.w, b.x + b.w);
+    int y2 = std::max(a.y + a.h, b.y + b.h);
+
+    a.x = x1;
+    a.y = y1;
+    a.w = x2 - x1;
+    a.h = y2 - y1;
+}
+
+/**
+ * Marks a rectangle of the screen surface (in screen pixels) as
+ * needing to be pushed to the display on the next redraw.  Touching
+ * rectangles are merged; if too many disjoint rectangles accumulate,
+ * they are collapsed into their bounding box.
+ */
+void screenDamage(int x, int y, int width, int height) {
+    SDL_Surface *surface = SDL_GetVideoSurface();
+    if (!surface)
+        return;
+
+    /* clip to the screen */
+    if (x < 0) { width += x; x = 0; }
+    if (y < 0) { height += y; y = 0; }
+    if (x + width > surface->w)
+        width = surface->w - x;
+    if (y + height > surface->h)
+        height = surface->h - y;
+    if (width <= 0 || height <= 0)
+        return;
+
+    SDL_Rect r;
+    r.x = x;
+    r.y = y;
+    r.w = width;
+    r.h = height;
+
+    if (screenDamageMutex)
+        SDL_mutexP(screenDamageMutex);
+
+    if (screenPendingDamage++ == 0)
+        screenFirstDamageTime = SDL_GetTicks();
+
+    /* absorb every existing rectangle that the new one touches */
+    int i = 0;
+    while (i < screenDamageCount) {
+        if (screenRectsTouch(screenDamageRects[i], r)) {
+            screenRectUnion(r, screenDamageRects[i]);
+            screenDamageRects[i] = screenDamageRects[--screenDamageCount];
+            i = 0;
+        }
+        else
+            i++;
+    }
+
+    if (screenDamageCount == SCR_DAMAGE_MAX) {
+        for (i = 0; i < screenDamageCount; i++)
+            screenRectUnion(r, screenDamageRects[i]);
+        screenDamageCount = 0;
+    }
+    screenDamageRects[screenDamageCount++] = r;
+
+    /* wake the refresh thread if it was idle */
+    if (screenDamageCount == 1 && screenDamageCond)
+        SDL_CondSignal(screenDamageCond);
+
+    if (screenDamageMutex)
+        SDL_mutexV(screenDamageMutex);
+}
+
+/**
+ * Marks the whole screen as needing to be pushed to the display.
+ */
+void screenDamageAll() {
+    SDL_Surface *surface = SDL_GetVideoSurface();
+    if (surface)
+        screenDamage(0, 0, surface->w, surface->h);
+}
+
 void screenRedrawScreen() {
-	screenLock();
-    SDL_UpdateRect(SDL_GetVideoSurface(), 0, 0, 0, 0);
+    SDL_Rect rects[SCR_DAMAGE_MAX];
+    int n;
+
+    if (screenDamageMutex)
+        SDL_mutexP(screenDamageMutex);
+    n = screenDamageCount;
+    memcpy(rects, screenDamageRects, n * sizeof(SDL_Rect));
+    screenDamageCount = 0;
+    if (n > 0) {
+        Uint32 now = SDL_GetTicks();
+        Uint32 pending = now - screenFirstDamageTime;
+        if (frameDuration > 0 && pending > (Uint32)frameDuration)
+            screenSkippedFrames += (pending - 1) / frameDuration;
+        screenInvalidations += screenPendingDamage;
+        screenPendingDamage = 0;
+        screenLastPresentTime = now;
+        screenPresentCount++;
+        screenRatePresents++;
+    }
+    if (screenDamageMutex)
+        SDL_mutexV(screenDamageMutex);
+
+    if (n == 0)
+        return;
+
+    screenLock();
+    SDL_UpdateRects(SDL_GetVideoSurface(), n, rects);
     screenUnlock();
 }
 
@@ -235,16 +387,69 @@ void screenWait(int numberOfAnimationFrames) {
 bool continueScreenRefresh = true;
 SDL_Thread *screenRefreshThread = NULL;
 
+/**
+ * Sleeps until something has been drawn, then presents it.  Presents
+ * are held to at most one per frame, so everything drawn while the
+ * thread waits for the next frame goes out together.
+ */
 int screenRefreshThreadFunction(void *unused) {
+	profiler->nameThread("screen refresh");
 
+	SDL_mutexP(screenDamageMutex);
 	while (continueScreenRefresh) {
-		SDL_Delay(frameDuration);
+		if (screenDamageCount == 0) {
+			SDL_CondWait(screenDamageCond, screenDamageMutex);
+			continue;
+		}
+
+		bool presented = screenPresentCount > 0;
+		Uint32 sinceLast = SDL_GetTicks() - screenLastPresentTime;
+		SDL_mutexV(screenDamageMutex);
+
+		if (presented && sinceLast < (Uint32)frameDuration)
+			SDL_Delay(frameDuration - sinceLast);
 		screenRedrawScreen();
+
+		SDL_mutexP(screenDamageMutex);
 	}
+	SDL_mutexV(screenDamageMutex);
+
+	return 0;
+}
+
+/**
+ * Returns the refresh statistics.  The present rate covers the time
+ * since the previous call, or since the refresh thread started.
+ */
+ScreenRefreshStats screenGetRefreshStats() {
+	ScreenRefreshStats stats;
+
+	if (screenDamageMutex)
+		SDL_mutexP(screenDamageMutex);
+
+	Uint32 now = SDL_GetTicks();
+	stats.presents = screenPresentCount;
+	stats.skippedFrames = screenSkippedFrames;
+	stats.invalidations = screenInvalidations;
+	stats.presentRate = now != screenRateStartTime ?
+		screenRatePresents * 1000.0f / (now - screenRateStartTime) : 0.0f;
+	screenRatePresents = 0;
+	screenRateStartTime = now;
+
+	if (screenDamageMutex)
+		SDL_mutexV(screenDamageMutex);
+
+	return stats;
 }
 
 void screenRefreshThreadInit() {
 	screenLockMutex = SDL_CreateMutex();;
+	if (!screenDamageMutex)
+		screenDamageMutex = SDL_CreateMutex();
+	if (!screenDamageCond)
+		screenDamageCond = SDL_CreateCond();
+	screenRatePresents = 0;
+	screenRateStartTime = SDL_GetTicks();
 
 	frameDuration = 1000 / settings.screenAnimationFramesPerSecond;
 
@@ -262,9 +467,19 @@ void screenRefreshThreadInit() {
 }
 
 void screenRefreshThreadEnd() {
+	SDL_mutexP(screenDamageMutex);
 	continueScreenRefresh = false;
+	SDL_CondSignal(screenDamageCond);
+	SDL_mutexV(screenDamageMutex);
+
 	SDL_WaitThread(screenRefreshThread, NULL);
 	screenRefreshThread = NULL;
+
+	if (verbose) {
+		ScreenRefreshStats stats = screenGetRefreshStats();
+		printf("screen refresh: %u presents (%.1f per second) of %u invalidations, %u frames skipped\n",
+		       stats.presents, stats.presentRate, stats.invalidations, stats.skippedFrames);
+	}
 }
 
 
@@ -276,6 +491,17 @@ void screenRefreshThreadEnd() {
  * resulting image.
  */
 Image *screenScale(Image *src, int scale, int n, int filter) {
+    return screenScaleWith(src, scale, n, filter, filterScaler, scaler3x(settings.filter), Image::HARDWARE);
+}
+
+/**
+ * Scales an image up like screenScale(), but with the given filter
+ * scaler, which is also used for 3x scaling if filter3x is set, and
+ * into an image of the given type.  Doesn't look at the settings or
+ * the screen, so it can be used from a worker thread with a software
+ * image.
+ */
+Image *screenScaleWith(Image *src, int scale, int n, int filter, Scaler scaler, bool filter3x, Image::Type type) {
     Image *dest = NULL;
 	bool isTransparent;
 	unsigned int transparentIndex;
@@ -287,22 +513,22 @@ Image *screenScale(Image *src, int scale, int n, int filter) {
 	isTransparent = src->getTransparentIndex(transparentIndex);
 	src->alphaOff();
 
-	while (filter && filterScaler && (scale % 2 == 0)) {
-		dest = (*filterScaler)(src, 2, n);
+	while (filter && scaler && (scale % 2 == 0)) {
+		dest = (*scaler)(src, 2, n, type);
 		src = dest;
 		scale /= 2;
 	}
-	if (scale == 3 && scaler3x(settings.filter)) {
-		dest = (*filterScaler)(src, 3, n);
+	if (scale == 3 && filter3x) {
+		dest = (*scaler)(src, 3, n, type);
 		src = dest;
 		scale /= 3;
 	}
 
 	if (scale != 1)
-		dest = (*scalerGet("point"))(src, scale, n);
+		dest = (*scalerGet("point"))(src, scale, n, type);
 
 	if (!dest)
-		dest = Image::duplicate(src);
+		dest = Image::duplicate(src, type);
 
 	if (isTransparent)
 		dest->setTransparentIndex(transparentIndex);
@@ -341,13 +567,18 @@ Image *screenScaleDown(Image *src, int scale) {
     if (dest->isIndexed())
         dest->setPaletteFromImage(src);
 
-    for (y = 0; y < src->height(); y+=scale) {
-        for (x = 0; x < src->width(); x+=scale) {
-            unsigned int index;
-            src->getPixelIndex(x, y, index);                
-            dest->putPixelIndex(x / scale, y / scale, index);
+    {
+        /* keep every scale'th pixel of every scale'th row */
+        std::vector<unsigned int> row(src->width());
+        ImageLock srcLock(src), destLock(dest);
+
+        for (y = 0; y < dest->height(); y++) {
+            src->getSpan(0, y * scale, src->width(), &row[0]);
+            for (x = 0; x < dest->width(); x++)
+                row[x] = row[x * scale];
+            dest->putSpan(0, y, dest->width(), &row[0]);
         }
-    }    
+    }
 
     if (isTransparent)
         dest->setTransparentIndex(transparentIndex);
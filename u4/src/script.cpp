@@ -20,6 +20,7 @@
 #include "game.h"
 #include "music.h"
 #include "player.h"
+#include "profiler.h"
 #include "savegame.h"
 #include "screen.h"
 #include "settings.h"
@@ -283,6 +284,7 @@ void Script::unload() {
  * Executes the subscript 'script' of the main script
  */ 
 Script::ReturnCode Script::execute(xmlNodePtr script, xmlNodePtr currentItem, string *output) {
+    PROFILE_ZONE("Script::execute()");
     xmlNodePtr current;    
     Script::ReturnCode retval = RET_OK;
     
@@ -0,0 +1,116 @@
+/*
+ * $Id$
+ */
+
+#include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
+
+#include <cstring>
+
+#include "textlayout.h"
+
+#include "textcolor.h"
+
+#define TEXT_CURSOR_RIGHT 0x12
+
+/**
+ * Returns true if the character ends a word.  FG_GREY isn't among
+ * them, so a grey color change sticks to the word that follows it.
+ */
+static bool textIsWordBreak(char ch) {
+    switch (ch) {
+    case ' ':
+    case '\b':
+    case '\t':
+    case '\n':
+    case FG_BLUE:
+    case FG_PURPLE:
+    case FG_GREEN:
+    case FG_RED:
+    case FG_YELLOW:
+    case FG_WHITE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool textIsColor(char ch) {
+    return ch >= FG_GREY && ch <= FG_WHITE;
+}
+
+TextLayout::TextLayout(int columns, int rows) : columns(columns), rows(rows), col(0), line(0) {}
+
+/**
+ * Lays out the text starting at the given cursor position.  A word
+ * that doesn't fit on the current line goes on the next one, and the
+ * area scrolls whenever the cursor moves past its last line.
+ */
+void TextLayout::layout(const char *text, int col, int line) {
+    int len = strlen(text);
+
+    this->col = col;
+    this->line = line;
+    ops.clear();
+
+    wordLengths.resize(len + 1);
+    wordLengths[len] = 0;
+    for (int i = len - 1; i >= 0; i--)
+        wordLengths[i] = textIsWordBreak(text[i]) ? 0 : wordLengths[i + 1] + 1;
+
+    if (this->line == rows) {
+        ops.push_back(TextLayoutOp(TextLayoutOp::SCROLL, 0, 0, 0));
+        this->line--;
+    }
+
+    int i = 0;
+    while (i < len) {
+        char ch = text[i];
+
+        /* backspace */
+        if (ch == '\b') {
+            if (--this->col < 0) {
+                this->col += columns;
+                this->line--;
+            }
+            i++;
+            continue;
+        }
+
+        /* color-change codes */
+        if (textIsColor(ch)) {
+            ops.push_back(TextLayoutOp(TextLayoutOp::SET_COLOR, ch, this->col, this->line));
+            i++;
+            continue;
+        }
+
+        /* check for word wrap; a word too long for any line is split at the edge */
+        if ((this->col > 0 && this->col + wordLengths[i] > columns) || ch == '\n' || this->col == columns) {
+            if (ch == '\n' || ch == ' ')
+                i++;
+            newLine();
+            continue;
+        }
+
+        /* code for move cursor right */
+        if (ch == TEXT_CURSOR_RIGHT) {
+            this->col++;
+            i++;
+            continue;
+        }
+
+        /* don't show a space in column 1.  Helps with Hawkwind. */
+        if (ch != ' ' || this->col != 0) {
+            ops.push_back(TextLayoutOp(TextLayoutOp::DRAW_CHAR, ch, this->col, this->line));
+            this->col++;
+        }
+        i++;
+    }
+}
+
+void TextLayout::newLine() {
+    this->col = 0;
+    if (++this->line == rows) {
+        ops.push_back(TextLayoutOp(TextLayoutOp::SCROLL, 0, 0, 0));
+        this->line--;
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ * $Id$
+ */
+
+#ifndef TEXTLAYOUT_H
+#define TEXTLAYOUT_H
+
+#include <vector>
+
+/**
+ * One step in drawing a piece of laid out text.
+ */
+struct TextLayoutOp {
+    enum Type {
+        DRAW_CHAR,      /**< draw ch at col, line */
+        SET_COLOR,      /**< switch to the text color ch */
+        SCROLL          /**< scroll the text area up a line */
+    };
+
+    TextLayoutOp(Type t, int c, int x, int y) : type(t), ch(c), col(x), line(y) {}
+
+    Type type;
+    int ch;
+    int col, line;
+};
+
+/**
+ * Lays out text for a text area that wraps at word boundaries, such
+ * as the message area.  The text is scanned once to find where each
+ * word ends, and then once more to wrap it and turn it into a list of
+ * drawing steps.  Color changes, backspaces and cursor-right codes
+ * are handled along the way.
+ */
+class TextLayout {
+public:
+    TextLayout(int columns, int rows);
+
+    void layout(const char *text, int col, int line);
+
+    const std::vector<TextLayoutOp> &getOps() const { return ops; }
+    int getCol() const { return col; }      /**< the column after the last step */
+    int getLine() const { return line; }    /**< the line after the last step */
+
+private:
+    void newLine();
+
+    int columns, rows;
+    int col, line;
+    std::vector<TextLayoutOp> ops;
+    std::vector<int> wordLengths;   /**< characters left in the word at each position */
+};
+
+#endif /* TEXTLAYOUT_H */
@@ -15,6 +15,16 @@
 #include "textview.h"
 
 Image *TextView::charset = NULL;
+ColorFG TextView::fontFG = ColorFG(0);
+ColorBG TextView::fontBG = ColorBG(0);
+Image *TextView::glyphs[TEXT_FG_COLORS + 1][TEXT_BG_COLORS + 1];
+Image *TextView::glyphsCharset = NULL;
+RGBA TextView::charsetColors[4];
+
+/* the palette entries that the font colors change */
+static const unsigned int fontColorIndexes[4] = {
+    TEXT_FG_PRIMARY_INDEX, TEXT_FG_SECONDARY_INDEX, TEXT_FG_SHADOW_INDEX, TEXT_BG_INDEX
+};
 
 TextView::TextView(int x, int y, int columns, int rows) : View(x, y, columns * CHAR_WIDTH, rows * CHAR_HEIGHT) {
     this->columns = columns;
@@ -45,11 +55,11 @@ void TextView::drawChar(int chr, int x, int y) {
     ASSERT(x < columns, "x value of %d out of range", x);
     ASSERT(y < rows, "y value of %d out of range", y);
 
-    charset->drawSubRect(SCALED(this->x + (x * CHAR_WIDTH)),
-                         SCALED(this->y + (y * CHAR_HEIGHT)),
-                         0, SCALED(chr * CHAR_HEIGHT),
-                         SCALED(CHAR_WIDTH),
-                         SCALED(CHAR_HEIGHT));
+    getGlyphs()->drawSubRect(SCALED(this->x + (x * CHAR_WIDTH)),
+                             SCALED(this->y + (y * CHAR_HEIGHT)),
+                             0, SCALED(chr * CHAR_HEIGHT),
+                             SCALED(CHAR_WIDTH),
+                             SCALED(CHAR_HEIGHT));
 }
 
 /**
@@ -140,15 +150,70 @@ string TextView::colorizeString(string input, ColorFG color, unsigned int colors
 }
 
 void TextView::setFontColor(ColorFG fg, ColorBG bg) {
-    charset->setFontColorFG(fg);
-    charset->setFontColorBG(bg);
+    fontFG = fg;
+    fontBG = bg;
 }
 
 void TextView::setFontColorFG(ColorFG fg) {
-    charset->setFontColorFG(fg);
+    fontFG = fg;
 }
 void TextView::setFontColorBG(ColorBG bg) {
-    charset->setFontColorBG(bg);
+    fontBG = bg;
+}
+
+/**
+ * Returns the font drawn in the current colors, ready to be copied to
+ * the screen a character at a time.  Each pair of colors is drawn
+ * from the charset's palette once, the first time it is used, rather
+ * than rewriting the shared palette on every color change.  The
+ * charset gets its own palette back afterwards, since the dungeon gem
+ * view draws straight from it.
+ */
+Image *TextView::getGlyphs() {
+    if (charset == NULL)
+        charset = imageMgr->get(BKGD_CHARSET)->image;
+    if (charset != glyphsCharset) {
+        deleteGlyphs();
+        glyphsCharset = charset;
+        for (int i = 0; i < 4; i++)
+            charsetColors[i] = charset->getPaletteColor(fontColorIndexes[i]);
+    }
+
+    /* a charset without a palette can't be recolored, so one copy will do */
+    int fg = (fontFG && charset->isIndexed()) ? fontFG - FG_GREY + 1 : 0;
+    int bg = (fontBG && charset->isIndexed()) ? fontBG - BG_NORMAL + 1 : 0;
+    ASSERT(fg >= 0 && fg <= TEXT_FG_COLORS, "invalid text color: %d", fontFG);
+    ASSERT(bg >= 0 && bg <= TEXT_BG_COLORS, "invalid text background color: %d", fontBG);
+
+    if (glyphs[fg][bg] == NULL) {
+        if (fg)
+            charset->setFontColorFG(fontFG);
+        if (bg)
+            charset->setFontColorBG(fontBG);
+        glyphs[fg][bg] = Image::duplicateForScreen(charset);
+        for (int i = 0; i < 4; i++)
+            charset->setPaletteIndex(fontColorIndexes[i], charsetColors[i]);
+    }
+    return glyphs[fg][bg];
+}
+
+/**
+ * Forgets the charset and frees the fonts drawn from it, for when the
+ * images are about to be reloaded, e.g. at another scale.
+ */
+void TextView::flushGlyphs() {
+    deleteGlyphs();
+    charset = NULL;
+}
+
+void TextView::deleteGlyphs() {
+    for (int fg = 0; fg <= TEXT_FG_COLORS; fg++) {
+        for (int bg = 0; bg <= TEXT_BG_COLORS; bg++) {
+            delete glyphs[fg][bg];
+            glyphs[fg][bg] = NULL;
+        }
+    }
+    glyphsCharset = NULL;
 }
 
 void TextView::textAt(int x, int y, const char *fmt, ...) {
@@ -14,8 +14,12 @@
 #define CHAR_WIDTH 8
 #define CHAR_HEIGHT 8
 
+#define TEXT_FG_COLORS (FG_WHITE - FG_GREY + 1)
+#define TEXT_BG_COLORS (BG_BRIGHT - BG_NORMAL + 1)
+
 #include "view.h"
 #include "image.h"
+#include "textcolor.h"
 
 /**
  * A view of a text area.  Keeps track of the cursor position.
@@ -44,10 +48,12 @@ public:
     void drawCursor();
     static void cursorTimer(void *data);
 
-    // functions to modify the charset font palette
-    void setFontColor(ColorFG fg, ColorBG bg);
-    void setFontColorFG(ColorFG fg);
-    void setFontColorBG(ColorBG bg);
+    // functions to pick the charset font colors
+    static void setFontColor(ColorFG fg, ColorBG bg);
+    static void setFontColorFG(ColorFG fg);
+    static void setFontColorBG(ColorBG bg);
+    static Image *getGlyphs();
+    static void flushGlyphs();
 
     // functions to add color to strings
     void textSelectedAt(int x, int y, const char *text);
@@ -56,12 +62,19 @@ public:
 
 
 protected:
+    static void deleteGlyphs();
+
     int columns, rows;          /**< size of the view in character cells  */
     bool cursorEnabled;         /**< whether the cursor is enabled */
     bool cursorFollowsText;     /**< whether the cursor is moved past the last character written */
     int cursorX, cursorY;       /**< current position of cursor */
     int cursorPhase;            /**< the rotation state of the cursor */
     static Image *charset;      /**< image containing font */
+    static ColorFG fontFG;      /**< current text color, or 0 for the charset's own */
+    static ColorBG fontBG;      /**< current text background color, or 0 for the charset's own */
+    static Image *glyphs[TEXT_FG_COLORS + 1][TEXT_BG_COLORS + 1]; /**< the font drawn in each pair of colors, made when first used */
+    static Image *glyphsCharset;/**< the charset image the glyphs were drawn from */
+    static RGBA charsetColors[4];/**< the charset's own font palette entries */
 };
 
 #endif /* TEXTVIEW_H */
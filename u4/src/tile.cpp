@@ -37,7 +37,7 @@ Tile::Tile(Tileset *tileset)
     , rule(NULL)
     , imageName()
     , looks_like()
-    , image(NULL)
+    , firstFrame(-1)
     , tiledInDungeon(false)
     , directions()
     , animationRule("") {
@@ -102,17 +102,58 @@ void Tile::loadProperties(const ConfigElement &conf) {
     }
 }
 
+/**
+ * Returns the tileset atlas holding this tile's frames, or NULL if the
+ * tile's image couldn't be loaded.
+ */
 Image *Tile::getImage() {
-    if (!image)
+    if (firstFrame < 0)
         loadImage();
-    return image;
+    return firstFrame < 0 ? NULL : tileset->getAtlas();
+}
+
+/**
+ * Returns the position of the given frame within the atlas, or NULL
+ * if the tile has no such frame.
+ */
+const TileFrameRect *Tile::getFrameRect(int frame) {
+    if (!getImage() || frame < 0 || frame >= frames)
+        return NULL;
+    return &tileset->getFrameRect(firstFrame + frame);
+}
+
+/**
+ * Draws a frame of the tile onto another image.
+ */
+void Tile::drawOn(Image *dest, int x, int y, int frame) {
+    drawSubRectOn(dest, x, y, frame, 0, 0, w, h);
+}
+
+/**
+ * Draws a piece of a frame of the tile onto another image.  The
+ * rectangle rx, ry, rw, rh is relative to the frame, and is clipped to
+ * it so that neighbouring frames in the atlas never show through.
+ */
+void Tile::drawSubRectOn(Image *dest, int x, int y, int frame, int rx, int ry, int rw, int rh) {
+    const TileFrameRect *rect = getFrameRect(frame);
+    if (!rect)
+        return;
+
+    if (rx + rw > w)
+        rw = w - rx;
+    if (ry + rh > h)
+        rh = h - ry;
+    if (rw <= 0 || rh <= 0)
+        return;
+
+    tileset->getAtlas()->drawSubRectOn(dest, x, y, rect->x + rx, rect->y + ry, rw, rh);
 }
 
 /**
- * Loads the tile image
+ * Loads the tile image into the tileset atlas
  */ 
 void Tile::loadImage() {
-    if (!image) {
+    if (firstFrame < 0) {
         scale = settings.scale;
 
     	SubImage *subimage = NULL;
@@ -147,17 +188,12 @@ void Tile::loadImage() {
         if (info) {
             w = (subimage ? subimage->width * scale : info->width * scale / info->prescale);
             h = (subimage ? (subimage->height * scale) / frames : (info->height * scale / info->prescale) / frames);
-            image = Image::create(w, h * frames, false, Image::HARDWARE);
-
-
-            //info->image->alphaOff();
 
-            /* draw the tile from the image we found to our tile image */
-            if (subimage) {
-                Image *tiles = info->image;
-                tiles->drawSubRectOn(image, 0, 0, subimage->x * scale, subimage->y * scale, subimage->width * scale, subimage->height * scale);
-            }
-            else info->image->drawOn(image, 0, 0);
+            /* copy the frames from the image we found into the atlas */
+            if (subimage)
+                firstFrame = tileset->addToAtlas(info->image, subimage->x * scale, subimage->y * scale, w, h, frames);
+            else
+                firstFrame = tileset->addToAtlas(info->image, 0, 0, w, h, frames);
         }
 
         if (animationRule.size() > 0) {
@@ -180,10 +216,7 @@ void Tile::loadImage() {
 
 void Tile::deleteImage()
 {
-    if(image) {
-        delete image;
-        image = NULL;
-    }
+    firstFrame = -1;
     scale = settings.scale;
 }
 
@@ -61,6 +61,9 @@ public:
     int getScale() const                {return scale;}
     TileAnim *getAnim() const           {return anim;}
     Image *getImage();
+    const TileFrameRect *getFrameRect(int frame);
+    void drawOn(Image *dest, int x, int y, int frame);
+    void drawSubRectOn(Image *dest, int x, int y, int frame, int rx, int ry, int rw, int rh);
     const string &getLooksLike() const  {return looks_like;}
 
     bool isTiledInDungeon() const       {return tiledInDungeon;}
@@ -130,7 +133,7 @@ private:
     string imageName;   /**< The name of the image that belongs to this tile */
     string looks_like;  /**< The name of the tile that this tile looks exactly like (if any) */    
 
-    Image *image;       /**< The original image for this tile (with all of its frames) */
+    int firstFrame;     /**< The index of this tile's first frame in the tileset atlas, or -1 if not loaded */
     bool tiledInDungeon;
     vector<Direction> directions;
 
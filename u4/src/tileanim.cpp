@@ -100,6 +100,71 @@ RGBA *TileAnimTransform::loadColorFromConf(const ConfigElement &conf) {
     return rgba;
 }
 
+TileAnimTransform::~TileAnimTransform() {
+    flushFrames();
+}
+
+/**
+ * Frees the baked frames, e.g. when the tile images are reloaded at
+ * another scale or with another filter.
+ */
+void TileAnimTransform::flushFrames() {
+    for (FrameStripMap::iterator i = frameStrips.begin(); i != frameStrips.end(); i++)
+        delete i->second;
+    frameStrips.clear();
+}
+
+/**
+ * Returns the strip of baked frames for the given tile in its current
+ * frame, baking it first if it isn't there yet or the tile has been
+ * rescaled since.
+ */
+Image *TileAnimTransform::getFrameStrip(Tile *tile, MapTile &mapTile) {
+    int length = getStripLength(tile);
+    if (length <= 0 || !tile->getFrameRect(mapTile.frame))
+        return NULL;
+
+    std::pair<TileId, int> key(tile->getId(), mapTile.frame);
+    FrameStripMap::iterator i = frameStrips.find(key);
+    if (i != frameStrips.end()) {
+        Image *strip = i->second;
+        if (strip->width() == tile->getWidth() && strip->height() == tile->getHeight() * length)
+            return strip;
+        delete strip;
+        frameStrips.erase(i);
+    }
+
+    Image *strip = Image::create(tile->getWidth(), tile->getHeight() * length, false, Image::HARDWARE);
+    Image *frame = Image::create(tile->getWidth(), tile->getHeight(), false, Image::HARDWARE);
+    if (!strip || !frame) {
+        delete strip;
+        delete frame;
+        return NULL;
+    }
+
+    /*
+     * the tile is blended onto the frame, which keeps the frame's own
+     * alpha, so the frame starts out opaque black like the scratch
+     * image in TileView::drawTile(); blits out of the strip then copy
+     * that opaque alpha along with the pixels
+     */
+    strip->alphaOff();
+    frame->alphaOff();
+    for (int index = 0; index < length; index++) {
+        frame->fillRect(0, 0, tile->getWidth(), tile->getHeight(), 0, 0, 0, 255);
+        tile->drawOn(frame, 0, 0, mapTile.frame);
+        bakeFrame(frame, tile, mapTile, index);
+        frame->drawOn(strip, 0, index * tile->getHeight());
+    }
+    delete frame;
+
+    frameStrips[key] = strip;
+    return strip;
+}
+
+int TileAnimTransform::getStripLength(Tile *) const { return 1; }
+void TileAnimTransform::bakeFrame(Image *, Tile *, MapTile &, int) {}
+
 TileAnimInvertTransform::TileAnimInvertTransform(int x, int y, int w, int h) {
     this->x = x;
     this->y = y;
@@ -109,9 +174,18 @@ TileAnimInvertTransform::TileAnimInvertTransform(int x, int y, int w, int h) {
 
 bool TileAnimInvertTransform::drawsTile() const { return false; }
 void TileAnimInvertTransform::draw(Image *dest, Tile *tile, MapTile &mapTile) {    
+    Image *strip = getFrameStrip(tile, mapTile);
+    if (!strip)
+        return;
     int scale = tile->getScale();
-    tile->getImage()->drawSubRectInvertedOn(dest, x * scale, y * scale, x * scale,
-        (tile->getHeight() * mapTile.frame) + (y * scale), w * scale, h * scale);    
+    strip->drawSubRectOn(dest, x * scale, y * scale, x * scale, y * scale, w * scale, h * scale);
+}
+
+void TileAnimInvertTransform::bakeFrame(Image *dest, Tile *tile, MapTile &mapTile, int) {
+    int scale = tile->getScale();
+    const TileFrameRect *rect = tile->getFrameRect(mapTile.frame);
+    tile->getImage()->drawSubRectInvertedOn(dest, x * scale, y * scale, rect->x + (x * scale),
+        rect->y + (y * scale), w * scale, h * scale);    
 }
 
 TileAnimPixelTransform::TileAnimPixelTransform(int x, int y) {
@@ -121,7 +195,20 @@ TileAnimPixelTransform::TileAnimPixelTransform(int x, int y) {
 
 bool TileAnimPixelTransform::drawsTile() const { return false; }
 void TileAnimPixelTransform::draw(Image *dest, Tile *tile, MapTile &mapTile) {
-    RGBA *color = colors[xu4_random(colors.size())];
+    Image *strip = getFrameStrip(tile, mapTile);
+    if (!strip)
+        return;
+    int scale = tile->getScale();
+    int index = xu4_random(colors.size());
+    strip->drawSubRectOn(dest, x * scale, y * scale, x * scale, index * tile->getHeight() + y * scale, scale, scale);
+}
+
+/**
+ * One frame for each of the colors.
+ */
+int TileAnimPixelTransform::getStripLength(Tile *) const { return colors.size(); }
+void TileAnimPixelTransform::bakeFrame(Image *dest, Tile *tile, MapTile &, int index) {
+    RGBA *color = colors[index];
     int scale = tile->getScale();
     dest->fillRect(x * scale, y * scale, scale, scale, color->r, color->g, color->b, color->a);
 }
@@ -139,11 +226,30 @@ void TileAnimScrollTransform::draw(Image *dest, Tile *tile, MapTile &mapTile) {
         if (current >= tile->getHeight())
             current = 0;
     }
-    
-    tile->getImage()->drawSubRectOn(dest, 0, current, 0, tile->getHeight() * mapTile.frame, tile->getWidth(), tile->getHeight() - current);
-    if (current != 0)
-        tile->getImage()->drawSubRectOn(dest, 0, 0, 0, (tile->getHeight() * mapTile.frame) + tile->getHeight() - current, tile->getWidth(), current);
 
+    Image *strip = getFrameStrip(tile, mapTile);
+    int index = current / increment;
+    if (strip && index < getStripLength(tile))
+        strip->drawSubRectOn(dest, 0, 0, 0, index * tile->getHeight(), tile->getWidth(), tile->getHeight());
+    else
+        bakeFrame(dest, tile, mapTile, index);
+}
+
+/**
+ * One frame for each step the tile's contents can be scrolled by.
+ */
+int TileAnimScrollTransform::getStripLength(Tile *tile) const {
+    if (increment <= 0)
+        return 0;
+    return (tile->getHeight() + increment - 1) / increment;
+}
+
+void TileAnimScrollTransform::bakeFrame(Image *dest, Tile *tile, MapTile &mapTile, int index) {
+    int offset = index * increment;
+
+    tile->drawSubRectOn(dest, 0, offset, mapTile.frame, 0, 0, tile->getWidth(), tile->getHeight() - offset);
+    if (offset != 0)
+        tile->drawSubRectOn(dest, 0, 0, mapTile.frame, 0, tile->getHeight() - offset, tile->getWidth(), offset);
 }
 
 /**
@@ -153,7 +259,7 @@ bool TileAnimFrameTransform::drawsTile() const { return true; }
 void TileAnimFrameTransform::draw(Image *dest, Tile *tile, MapTile &mapTile) {
     if (++currentFrame >= tile->getFrames())
     	currentFrame = 0;
-    tile->getImage()->drawSubRectOn(dest, 0, 0, 0, currentFrame * tile->getHeight(), tile->getWidth(), tile->getHeight());
+    tile->drawOn(dest, 0, 0, currentFrame);
 
 
 }
@@ -167,6 +273,16 @@ TileAnimPixelColorTransform::TileAnimPixelColorTransform(int x, int y, int w, in
 
 bool TileAnimPixelColorTransform::drawsTile() const { return false; }
 void TileAnimPixelColorTransform::draw(Image *dest, Tile *tile, MapTile &mapTile) {
+    Image *strip = getFrameStrip(tile, mapTile);
+    if (!strip)
+        return;
+    int scale = tile->getScale();
+    int index = xu4_random(TILEANIM_PIXEL_COLOR_VARIANTS);
+    strip->drawSubRectOn(dest, x * scale, y * scale, x * scale, index * tile->getHeight() + y * scale, w * scale, h * scale);
+}
+
+int TileAnimPixelColorTransform::getStripLength(Tile *) const { return TILEANIM_PIXEL_COLOR_VARIANTS; }
+void TileAnimPixelColorTransform::bakeFrame(Image *dest, Tile *tile, MapTile &mapTile, int) {
     RGBA diff = *end;
     int scale = tile->getScale();
     diff.r -= start->r;
@@ -174,18 +290,37 @@ void TileAnimPixelColorTransform::draw(Image *dest, Tile *tile, MapTile &mapTile
     diff.b -= start->b;
 
     Image *tileImage = tile->getImage();
+    const TileFrameRect *rect = tile->getFrameRect(mapTile.frame);
+    if (!rect)
+        return;
+
+    int span = w * scale;
+    if (span <= 0)
+        return;
+
+    /* recolor a row at a time, leaving the pixels outside the color range as they were */
+    std::vector<uint8_t> src(span * 4), out(span * 4);
+    ImageLock tileLock(tileImage), destLock(dest);
 
     for (int j = y * scale; j < (y * scale) + (h * scale); j++) {
-        for (int i = x * scale; i < (x * scale) + (w * scale); i++) {
-            RGBA pixelAt;
-            
-            tileImage->getPixel(i, j + (mapTile.frame * tile->getHeight()), pixelAt.r, pixelAt.g, pixelAt.b, pixelAt.a);
-            if (pixelAt.r >= start->r && pixelAt.r <= end->r &&
-                pixelAt.g >= start->g && pixelAt.g <= end->g &&
-                pixelAt.b >= start->b && pixelAt.b <= end->b) {
-                dest->putPixel(i, j, start->r + xu4_random(diff.r), start->g + xu4_random(diff.g), start->b + xu4_random(diff.b), pixelAt.a);
+        tileImage->getSpanRGBA(rect->x + x * scale, rect->y + j, span, &src[0]);
+        dest->getSpanRGBA(x * scale, j, span, &out[0]);
+
+        for (int i = 0; i < span; i++) {
+            const uint8_t *pixelAt = &src[i * 4];
+            uint8_t *pixelOut = &out[i * 4];
+
+            if (pixelAt[0] >= start->r && pixelAt[0] <= end->r &&
+                pixelAt[1] >= start->g && pixelAt[1] <= end->g &&
+                pixelAt[2] >= start->b && pixelAt[2] <= end->b) {
+                pixelOut[0] = start->r + xu4_random(diff.r);
+                pixelOut[1] = start->g + xu4_random(diff.g);
+                pixelOut[2] = start->b + xu4_random(diff.b);
+                pixelOut[3] = pixelAt[3];
             }
         }
+
+        dest->putSpanRGBA(x * scale, j, span, &out[0]);
     }
 }
 
@@ -276,6 +411,14 @@ TileAnim *TileAnimSet::getByName(const std::string &name) {
     return i->second;
 }
 
+/**
+ * Frees the frames baked by every animation in the set
+ */ 
+void TileAnimSet::flushFrames() {
+    for (TileAnimMap::iterator i = tileanims.begin(); i != tileanims.end(); i++)
+        i->second->flushFrames();
+}
+
 TileAnim::TileAnim(const ConfigElement &conf) : random(0) {
     name = conf.getString("name");
     if (conf.exists("random"))
@@ -303,7 +446,7 @@ void TileAnim::draw(Image *dest, Tile *tile, MapTile &mapTile, Direction dir) {
 
     /* nothing to do, draw the tile and return! */
     if ((random && xu4_random(100) > random) || (!transforms.size() && !contexts.size()) || mapTile.freezeAnimation) {
-        tile->getImage()->drawSubRectOn(dest, 0, 0, 0, mapTile.frame * tile->getHeight(), tile->getWidth(), tile->getHeight());
+        tile->drawOn(dest, 0, 0, mapTile.frame);
         return;
     }
     
@@ -315,7 +458,7 @@ void TileAnim::draw(Image *dest, Tile *tile, MapTile &mapTile, Direction dir) {
         
         if (!transform->random || xu4_random(100) < transform->random) {
             if (!transform->drawsTile() && !drawn)
-                tile->getImage()->drawSubRectOn(dest, 0, 0, 0, mapTile.frame * tile->getHeight(), tile->getWidth(), tile->getHeight());
+                tile->drawOn(dest, 0, 0, mapTile.frame);
             transform->draw(dest, tile, mapTile);
             drawn = true;
         }
@@ -332,7 +475,7 @@ void TileAnim::draw(Image *dest, Tile *tile, MapTile &mapTile, Direction dir) {
 
                 if (!transform->random || xu4_random(100) < transform->random) {
                     if (!transform->drawsTile() && !drawn)
-                        tile->getImage()->drawSubRectOn(dest, 0, 0, 0, mapTile.frame * tile->getHeight(), tile->getWidth(), tile->getHeight());
+                        tile->drawOn(dest, 0, 0, mapTile.frame);
                     transform->draw(dest, tile, mapTile);
                     drawn = true;
                 }
@@ -340,3 +483,20 @@ void TileAnim::draw(Image *dest, Tile *tile, MapTile &mapTile, Direction dir) {
         }
     }
 }
+
+/**
+ * Frees the frames baked by all of the animation's transforms.
+ */
+void TileAnim::flushFrames() {
+    std::vector<TileAnimTransform *>::const_iterator t;
+    std::vector<TileAnimContext *>::const_iterator c;
+
+    for (t = transforms.begin(); t != transforms.end(); t++)
+        (*t)->flushFrames();
+
+    for (c = contexts.begin(); c != contexts.end(); c++) {
+        TileAnimContext::TileAnimTransformList &ctx_transforms = (*c)->getTransforms();
+        for (t = ctx_transforms.begin(); t != ctx_transforms.end(); t++)
+            (*t)->flushFrames();
+    }
+}
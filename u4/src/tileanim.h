@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "direction.h"
+#include "types.h"
 
 class ConfigElement;
 class Image;
@@ -25,12 +26,26 @@ public:
     static RGBA *loadColorFromConf(const ConfigElement &conf);
     
     virtual void draw(Image *dest, Tile *tile, MapTile &mapTile) = 0;
-    virtual ~TileAnimTransform() {}
+    virtual ~TileAnimTransform();
     virtual bool drawsTile() const = 0;
+    void flushFrames();
     
     // Properties
     int random;
 
+protected:
+    typedef std::map<std::pair<TileId, int>, Image *> FrameStripMap;
+
+    Image *getFrameStrip(Tile *tile, MapTile &mapTile);
+    virtual int getStripLength(Tile *tile) const;
+    virtual void bakeFrame(Image *dest, Tile *tile, MapTile &mapTile, int index);
+
+    /**
+     * The animation's frames baked for each tile and tile frame,
+     * stacked top to bottom, so drawing only has to pick one.
+     */
+    FrameStripMap frameStrips;
+
 private:    
     bool replaces;
 };
@@ -44,6 +59,9 @@ public:
     TileAnimInvertTransform(int x, int y, int w, int h);
     virtual void draw(Image *dest, Tile *tile, MapTile &mapTile);
     virtual bool drawsTile() const;
+
+protected:
+    virtual void bakeFrame(Image *dest, Tile *tile, MapTile &mapTile, int index);
     
 private:
     int x, y, w, h;
@@ -60,6 +78,12 @@ public:
     virtual void draw(Image *dest, Tile *tile, MapTile &mapTile);
     virtual bool drawsTile() const;
 
+protected:
+    virtual int getStripLength(Tile *tile) const;
+    virtual void bakeFrame(Image *dest, Tile *tile, MapTile &mapTile, int index);
+
+public:
+
     int x, y;
     std::vector<RGBA *> colors;
 };
@@ -73,13 +97,17 @@ public:
     TileAnimScrollTransform(int increment);
     virtual void draw(Image *dest, Tile *tile, MapTile &mapTile);    
     virtual bool drawsTile() const;
+protected:
+    virtual int getStripLength(Tile *tile) const;
+    virtual void bakeFrame(Image *dest, Tile *tile, MapTile &mapTile, int index);
 private:
     int increment, current, lastOffset;
 };
 
 /**
  * A tile animation transformation that advances the tile's frame
- * by 1.
+ * by 1.  The tile's frames are already a strip in the tileset atlas,
+ * so nothing needs to be baked for it.
  */ 
 class TileAnimFrameTransform : public TileAnimTransform {
 public:
@@ -90,10 +118,13 @@ protected:
     int currentFrame;
 };
 
+#define TILEANIM_PIXEL_COLOR_VARIANTS 8
+
 /**
  * A tile animation transformation that changes pixels with colors
  * that fall in a given range to another color.  Used to animate
- * the campfire in VGA mode.
+ * the campfire in VGA mode.  A fixed number of random recolorings
+ * are baked, and each draw picks one of them.
  */ 
 class TileAnimPixelColorTransform : public TileAnimTransform {
 public:
@@ -101,6 +132,12 @@ public:
     virtual void draw(Image *dest, Tile *tile, MapTile &mapTile);
     virtual bool drawsTile() const;
 
+protected:
+    virtual int getStripLength(Tile *tile) const;
+    virtual void bakeFrame(Image *dest, Tile *tile, MapTile &mapTile, int index);
+
+public:
+
     int x, y, w, h;
     RGBA *start, *end;
 };
@@ -166,6 +203,7 @@ public:
 
     /* returns the frame to set the mapTile to (only relevent if persistent) */
     void draw(Image *dest, Tile *tile, MapTile &mapTile, Direction dir);     
+    void flushFrames();
 
     int random;   /* true if the tile animation occurs randomely */
 };
@@ -181,6 +219,7 @@ public:
     TileAnimSet(const ConfigElement &conf);
 
     TileAnim *getByName(const std::string &name);
+    void flushFrames();
 
     std::string name;
     TileAnimMap tileanims;
@@ -11,6 +11,7 @@
 #include "config.h"
 #include "debug.h"
 #include "error.h"
+#include "image.h"
 #include "screen.h"
 #include "settings.h"
 #include "tile.h"
@@ -152,6 +153,19 @@ bool TileRule::initFromConf(const ConfigElement &conf) {
 
 /* static member variables */
 Tileset::TilesetMap Tileset::tilesets;    
+std::vector<Tile*> Tileset::tilesById;
+
+/* the number of frames packed side by side in each row of an atlas */
+#define ATLAS_COLUMNS 16
+
+Tileset::Tileset()
+    : totalFrames(0)
+    , extends(NULL)
+    , atlas(NULL)
+    , shelfX(0)
+    , shelfY(0)
+    , shelfHeight(0) {
+}
 
 /**
  * Loads all tilesets using the filename
@@ -206,6 +220,7 @@ void Tileset::unloadAll() {
         delete i->second;
     }
     tilesets.clear();
+    tilesById.clear();
     
     Tile::resetNextId();
 }
@@ -247,17 +262,6 @@ Tile* Tileset::findTileByName(const string &name) {
     return NULL;
 }
 
-Tile* Tileset::findTileById(TileId id) {
-    TilesetMap::iterator i;
-    for (i = tilesets.begin(); i != tilesets.end(); i++) {
-        Tile *t = i->second->get(id);
-        if (t)
-            return t;        
-    }
-
-    return NULL;
-}
-
 /**
  * Loads a tileset.
  */
@@ -287,6 +291,11 @@ void Tileset::load(const ConfigElement &tilesetConf) {
         /* add the tile to our tileset */
         tiles[tile->getId()] = tile;
         nameMap[tile->getName()] = tile;
+
+        /* tile ids are handed out in sequence, so this table stays dense */
+        if (tile->getId() >= tilesById.size())
+            tilesById.resize(tile->getId() + 1, NULL);
+        tilesById[tile->getId()] = tile;
         
         index += tile->getFrames();
     }
@@ -302,6 +311,11 @@ void Tileset::unloadImages()
     {
     	i->second->deleteImage();
     }
+
+    delete atlas;
+    atlas = NULL;
+    frameRects.clear();
+    shelfX = shelfY = shelfHeight = 0;
 }
 
 /**
@@ -311,12 +325,20 @@ void Tileset::unload() {
     Tileset::TileIdMap::iterator i;    
         
     /* free all the memory for the tiles */
-    for (i = tiles.begin(); i != tiles.end(); i++)
+    for (i = tiles.begin(); i != tiles.end(); i++) {
+        if (i->first < tilesById.size())
+            tilesById[i->first] = NULL;
         delete i->second;    
+    }
 
     tiles.clear();
     totalFrames = 0;
     imageName.erase();    
+
+    delete atlas;
+    atlas = NULL;
+    frameRects.clear();
+    shelfX = shelfY = shelfHeight = 0;
 }
 
 /**
@@ -363,3 +385,61 @@ unsigned int Tileset::numTiles() const {
 unsigned int Tileset::numFrames() const {
     return totalFrames;
 }
+
+/**
+ * Copies the frames of a tile, stacked vertically in src starting at
+ * x, y, into the atlas.  Frames are packed left to right in rows; the
+ * atlas is sized for the whole tileset up front and only grows if the
+ * tiles turn out to be larger than the first one.  Returns the index of
+ * the first frame's entry in the frame table.
+ */
+int Tileset::addToAtlas(Image *src, int x, int y, int w, int h, int frames) {
+    int first = frameRects.size();
+
+    for (int i = 0; i < frames; i++) {
+        int width = atlas ? atlas->width() : w * ATLAS_COLUMNS;
+        int height = atlas ? atlas->height() : 0;
+
+        if (shelfX + w > width) {
+            shelfX = 0;
+            shelfY += shelfHeight;
+            shelfHeight = 0;
+        }
+
+        TileFrameRect rect;
+        rect.x = shelfX;
+        rect.y = shelfY;
+        shelfX += w;
+        if (h > shelfHeight)
+            shelfHeight = h;
+
+        if (!atlas) {
+            int rows = (totalFrames + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+            growAtlas(width, (rows > 0 ? rows : 1) * h);
+        }
+        else if (w > width || rect.y + h > height)
+            growAtlas(w > width ? w : width, rect.y + h > height ? (rect.y + h) * 2 : height);
+
+        src->drawSubRectOn(atlas, rect.x, rect.y, x, y + i * h, w, h);
+        frameRects.push_back(rect);
+    }
+
+    return first;
+}
+
+/**
+ * Replaces the atlas with a larger one, keeping the frames already
+ * packed where they are.
+ */
+void Tileset::growAtlas(int width, int height) {
+    Image *grown = Image::create(width, height, false, Image::HARDWARE);
+    if (!grown)
+        errorFatal("Error: unable to create a %dx%d atlas for tileset '%s'", width, height, name.c_str());
+
+    if (atlas) {
+        atlas->alphaOff();
+        atlas->drawOn(grown, 0, 0);
+        delete atlas;
+    }
+    atlas = grown;
+}
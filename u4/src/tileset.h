@@ -7,11 +7,13 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include "types.h"
 
 using std::string;
 
 class ConfigElement;
+class Image;
 class Tile;
 
 typedef std::map<string, class TileRule *> TileRuleMap;
@@ -36,11 +38,20 @@ public:
     int walkoffDirs;
 };
 
+/**
+ * The position of a single tile frame within its tileset's atlas.
+ */
+struct TileFrameRect {
+    int x, y;
+};
+
 /**
  * Tileset class
  */
 class Tileset {
 public:
+    Tileset();
+
     typedef std::map<string, Tileset*> TilesetMap;
     typedef std::map<TileId, Tile*> TileIdMap;
     typedef std::map<string, Tile*> TileStrMap;
@@ -51,7 +62,7 @@ public:
     static Tileset* get(const string &name);
 
     static Tile* findTileByName(const string &name);        
-    static Tile* findTileById(TileId id);        
+    static Tile* findTileById(TileId id)    {return id < tilesById.size() ? tilesById[id] : NULL;}
 
 public:
     void load(const ConfigElement &tilesetConf);
@@ -62,9 +73,16 @@ public:
     string getImageName() const;
     unsigned int numTiles() const;
     unsigned int numFrames() const;    
+
+    Image *getAtlas() const                             {return atlas;}
+    const TileFrameRect &getFrameRect(int index) const  {return frameRects[index];}
+    int addToAtlas(Image *src, int x, int y, int w, int h, int frames);
     
 private:
+    void growAtlas(int width, int height);
+
     static TilesetMap tilesets;
+    static std::vector<Tile*> tilesById;    /**< every loaded tile, indexed by its id */
 
     string name;
     TileIdMap tiles;
@@ -73,6 +91,10 @@ private:
     Tileset* extends;
 
     TileStrMap nameMap;
+
+    Image *atlas;                           /**< the frames of every loaded tile, packed into one image */
+    std::vector<TileFrameRect> frameRects;  /**< the position of each frame in the atlas */
+    int shelfX, shelfY, shelfHeight;        /**< where the next frame will be packed */
 };
 
 #endif
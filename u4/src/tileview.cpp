@@ -4,6 +4,9 @@
 
 #include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
 
+#include <algorithm>
+#include <cstdlib>
+
 #include "debug.h"
 #include "image.h"
 #include "imagemgr.h"
@@ -25,6 +28,7 @@ TileView::TileView(int x, int y, int columns, int rows) : View(x, y, columns * T
     this->tileHeight = TILE_HEIGHT;
     this->tileset = Tileset::get("base");
     animated = Image::create(SCALED(tileWidth), SCALED(tileHeight), false, Image::HARDWARE);
+    scrollBuffer = NULL;
 }
 
 TileView::TileView(int x, int y, int columns, int rows, const string &tileset) : View(x, y, columns * TILE_WIDTH, rows * TILE_HEIGHT) {
@@ -34,10 +38,13 @@ TileView::TileView(int x, int y, int columns, int rows, const string &tileset) :
     this->tileHeight = TILE_HEIGHT;
     this->tileset = Tileset::get(tileset);
     animated = Image::create(SCALED(tileWidth), SCALED(tileHeight), false, Image::HARDWARE);
+    scrollBuffer = NULL;
 }
 
 TileView::~TileView() {
+    flushCells();
     delete animated;
+    delete scrollBuffer;
 }
 
 void TileView::reinit() {
@@ -51,6 +58,10 @@ void TileView::reinit() {
     	animated = NULL;
     }
     animated = Image::create(SCALED(tileWidth), SCALED(tileHeight), false, Image::HARDWARE);
+
+    delete scrollBuffer;
+    scrollBuffer = NULL;
+    flushCells();
 }
 
 void TileView::loadTile(MapTile &mapTile)
@@ -66,7 +77,6 @@ void TileView::loadTile(MapTile &mapTile)
 
 void TileView::drawTile(MapTile &mapTile, bool focus, int x, int y) {
     Tile *tile = tileset->get(mapTile.id);
-    Image *image = tile->getImage();
 
     ASSERT(x < columns, "x value of %d out of range", x);
     ASSERT(y < rows, "y value of %d out of range", y);
@@ -98,12 +108,14 @@ void TileView::drawTile(MapTile &mapTile, bool focus, int x, int y) {
                               SCALED(tileHeight));
     }
     else {
-        image->drawSubRect(SCALED(x * tileWidth + this->x), 
-                           SCALED(y * tileHeight + this->y),
-                           0,
-                           SCALED(tileHeight * mapTile.frame),
-                           SCALED(tileWidth),
-                           SCALED(tileHeight));
+        tile->drawSubRectOn(NULL,
+                            SCALED(x * tileWidth + this->x),
+                            SCALED(y * tileHeight + this->y),
+                            mapTile.frame,
+                            0,
+                            0,
+                            SCALED(tileWidth),
+                            SCALED(tileHeight));
     }
 
     // draw the focus around the tile if it has the focus
@@ -111,65 +123,117 @@ void TileView::drawTile(MapTile &mapTile, bool focus, int x, int y) {
         drawFocus(x, y);
 }
 
-void TileView::drawTile(vector<MapTile> &tiles, bool focus, int x, int y) {
+void TileView::drawTile(TileStack &tiles, bool focus, int x, int y) {
 	ASSERT(x < columns, "x value of %d out of range", x);
 	ASSERT(y < rows, "y value of %d out of range", y);
 
-	animated->fillRect(0,0,SCALED(tileWidth),SCALED(tileHeight),0,0,0, 255);
-	animated->drawSubRect(SCALED(x * tileWidth + this->x),
-						  SCALED(y * tileHeight + this->y),
-						  0,
-						  0,
-						  SCALED(tileWidth),
-						  SCALED(tileHeight));
+	/* the layers from the bottom up to the first animated one always look the same */
+	int t = tiles.size() - 1;
+	cellKey.clear();
+	for (; t >= 0; t--) {
+		Tile *tileType = tileset->get(tiles[t].id);
+		if (!tileType || tileType->getAnim() || !tileType->getImage())
+			break;
+		cellKey.push_back(tiles[t].id);
+		cellKey.push_back(tiles[t].frame);
+	}
 
-	//int layer = 0;
+	if (cellKey.empty())
+		animated->fillRect(0,0,SCALED(tileWidth),SCALED(tileHeight),0,0,0, 255);
+	else {
+		Image *cell = getCell(cellKey);
 
-	for (vector<MapTile>::reverse_iterator t = tiles.rbegin();
-			t != tiles.rend();
-			++t)
+		/* nothing animated on top, so the cell goes straight to the screen */
+		if (t < 0) {
+			cell->drawSubRect(SCALED(x * tileWidth + this->x),
+							  SCALED(y * tileHeight + this->y),
+							  0,
+							  0,
+							  SCALED(tileWidth),
+							  SCALED(tileHeight));
+			if (focus)
+				drawFocus(x, y);
+			return;
+		}
+
+		cell->drawOn(animated, 0, 0);
+	}
+
+	for (; t >= 0; t--)
 	{
-		MapTile& frontTile = *t;
+		MapTile& frontTile = tiles[t];
 		Tile *frontTileType = tileset->get(frontTile.id);
 
-		if (!frontTileType)
+		if (!frontTileType || (!frontTileType->getAnim() && !frontTileType->getImage()))
 		{
 			//TODO, this leads to an error. It happens after graphics mode changes.
-			return;
+			//FIXME, error message it.
+			break;
 		}
 
-		Image *image = frontTileType->getImage();
-
-
-		// draw the tile to the screen
+		// draw the tile to the scratchpad
 		if (frontTileType->getAnim()) {
 			// First, create our animated version of the tile
 			frontTileType->getAnim()->draw(animated, frontTileType, frontTile, DIR_NONE);
 		}
 		else {
-            if (!image)
-                return; //This is a problem //FIXME, error message it. 
-			image->drawSubRectOn(animated,
+			frontTileType->drawSubRectOn(animated,
+								0, 0,
+								frontTile.frame,
 								0, 0,
-								0, SCALED(tileHeight * frontTile.frame),
 								SCALED(tileWidth),  SCALED(tileHeight));
 		}
-
-		// Then draw it to the screen
-		animated->drawSubRect(SCALED(x * tileWidth + this->x),
-							  SCALED(y * tileHeight + this->y),
-							  0,
-							  0,
-							  SCALED(tileWidth),
-							  SCALED(tileHeight));
 	}
 
+	// Then draw it to the screen
+	animated->drawSubRect(SCALED(x * tileWidth + this->x),
+						  SCALED(y * tileHeight + this->y),
+						  0,
+						  0,
+						  SCALED(tileWidth),
+						  SCALED(tileHeight));
 
 	// draw the focus around the tile if it has the focus
-	if (focus)
+	if (focus && t < 0)
         drawFocus(x, y);
 }
 
+/**
+ * Returns a cell with a stack of unanimated tiles drawn on black, the
+ * bottom one first.  The key holds the id and frame of each tile.
+ * Cells are kept, so a stack that has been seen before is drawn with
+ * a single blit.
+ */
+Image *TileView::getCell(const std::vector<unsigned int> &key) {
+    std::map<std::vector<unsigned int>, Image *>::iterator i = cells.find(key);
+    if (i != cells.end())
+        return i->second;
+
+    if (cells.size() >= TILEVIEW_CELL_CACHE_SIZE)
+        flushCells();
+
+    Image *cell = Image::create(SCALED(tileWidth), SCALED(tileHeight), false, Image::HARDWARE);
+    cell->fillRect(0, 0, SCALED(tileWidth), SCALED(tileHeight), 0, 0, 0, 255);
+    for (unsigned int k = 0; k < key.size(); k += 2)
+        tileset->get(key[k])->drawSubRectOn(cell, 0, 0, key[k + 1], 0, 0, SCALED(tileWidth), SCALED(tileHeight));
+
+    /* the cell is opaque, so it can be copied rather than blended */
+    cell->alphaOff();
+
+    cells[key] = cell;
+    return cell;
+}
+
+/**
+ * Throws away the cells made by getCell(), which must be done whenever
+ * the tile images might have changed.
+ */
+void TileView::flushCells() {
+    for (std::map<std::vector<unsigned int>, Image *>::iterator i = cells.begin(); i != cells.end(); i++)
+        delete i->second;
+    cells.clear();
+}
+
 /**
  * Draw a focus rectangle around the tile
  */
@@ -211,6 +275,35 @@ void TileView::drawFocus(int x, int y) {
     }
 }
 
+/**
+ * Moves the tiles already drawn in the view, so that each cell shows
+ * what was drawn dx columns and dy rows away from it.  The cells left
+ * uncovered along the edges keep what they had.
+ */
+void TileView::scroll(int dx, int dy) {
+    int w = SCALED((columns - abs(dx)) * tileWidth);
+    int h = SCALED((rows - abs(dy)) * tileHeight);
+    if (w <= 0 || h <= 0 || (dx == 0 && dy == 0))
+        return;
+
+    /* the screen is copied aside first rather than blitted onto itself */
+    if (!scrollBuffer) {
+        scrollBuffer = Image::create(SCALED(columns * tileWidth), SCALED(rows * tileHeight), false, Image::HARDWARE);
+        scrollBuffer->alphaOff();
+    }
+
+    screen->drawSubRectOn(scrollBuffer, 0, 0,
+                          SCALED(std::max(dx, 0) * tileWidth + this->x),
+                          SCALED(std::max(dy, 0) * tileHeight + this->y),
+                          w, h);
+    scrollBuffer->drawSubRectOn(screen,
+                                SCALED(std::max(-dx, 0) * tileWidth + this->x),
+                                SCALED(std::max(-dy, 0) * tileHeight + this->y),
+                                0, 0, w, h);
+}
+
 void TileView::setTileset(Tileset *tileset) {
+    if (tileset != this->tileset)
+        flushCells();
     this->tileset = tileset;
 }
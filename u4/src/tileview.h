@@ -5,6 +5,7 @@
 #ifndef TILEVIEW_H
 #define TILEVIEW_H
 
+#include <map>
 #include <vector>
 
 #include "view.h"
@@ -12,6 +13,9 @@
 class Tile;
 class Tileset;
 class MapTile;
+class TileStack;
+
+#define TILEVIEW_CELL_CACHE_SIZE 256
 
 /**
  * A view of a grid of tiles.  Used to draw Maps.
@@ -29,16 +33,24 @@ public:
 
     void reinit();
     void drawTile(MapTile &mapTile, bool focus, int x, int y);
-    void drawTile(std::vector<MapTile> &tiles, bool focus, int x, int y);
+    void drawTile(TileStack &tiles, bool focus, int x, int y);
     void drawFocus(int x, int y);
+    void scroll(int dx, int dy);
     void loadTile(MapTile &mapTile);
     void setTileset(Tileset *tileset);
+    void flushCells();
 
 protected:
+    Image *getCell(const std::vector<unsigned int> &key);
+
     int columns, rows;
     int tileWidth, tileHeight;
     Tileset *tileset;
     Image *animated;            /**< a scratchpad image for drawing animations */
+    Image *scrollBuffer;        /**< holds the view's contents while it is scrolled */
+
+    std::map<std::vector<unsigned int>, Image *> cells; /**< stacks of unanimated tiles already drawn together, see getCell() */
+    std::vector<unsigned int> cellKey;                  /**< the stack being looked up, kept to reuse its storage */
 };
 
 #endif /* TILEVIEW_H */
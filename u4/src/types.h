@@ -49,6 +49,7 @@ public:
     MapTile() : id(0), frame(0) {}
     MapTile(const TileId &i, unsigned char f = 0) : id(i), frame(f), freezeAnimation(false) {}
     MapTile(const MapTile &t) : id(t.id), frame(t.frame), freezeAnimation(t.freezeAnimation) {}
+    MapTile &operator=(const MapTile &t) { id = t.id; frame = t.frame; freezeAnimation = t.freezeAnimation; return *this; }
 
     TileId getId() const			{return id;}
     unsigned char getFrame() const	{return frame;}
@@ -71,6 +72,59 @@ public:
     bool freezeAnimation;
 };
 
+/* the number of tiles a TileStack holds before it needs the heap */
+#define TILESTACK_INLINE 8
+
+/**
+ * The stack of tiles drawn at a single map location, topmost first.
+ * The first few tiles are stored inline, so building and copying one
+ * doesn't touch the heap unless the stack is unusually deep.
+ */
+class TileStack {
+public:
+    TileStack() : tiles(inlineTiles), count(0), capacity(TILESTACK_INLINE) {}
+    TileStack(const TileStack &s) : tiles(inlineTiles), count(0), capacity(TILESTACK_INLINE) { *this = s; }
+    ~TileStack() { if (tiles != inlineTiles) delete [] tiles; }
+
+    TileStack &operator=(const TileStack &s) {
+        if (this != &s) {
+            clear();
+            for (unsigned int i = 0; i < s.count; i++)
+                push_back(s.tiles[i]);
+        }
+        return *this;
+    }
+
+    void push_back(const MapTile &tile) {
+        if (count == capacity)
+            grow();
+        tiles[count++] = tile;
+    }
+    void clear()                                        {count = 0;}
+
+    unsigned int size() const                           {return count;}
+    bool empty() const                                  {return count == 0;}
+    MapTile &front()                                    {return tiles[0];}
+    const MapTile &front() const                        {return tiles[0];}
+    MapTile &operator[](unsigned int i)                 {return tiles[i];}
+    const MapTile &operator[](unsigned int i) const     {return tiles[i];}
+
+private:
+    void grow() {
+        MapTile *grown = new MapTile[capacity * 2];
+        for (unsigned int i = 0; i < count; i++)
+            grown[i] = tiles[i];
+        if (tiles != inlineTiles)
+            delete [] tiles;
+        tiles = grown;
+        capacity *= 2;
+    }
+
+    MapTile inlineTiles[TILESTACK_INLINE];
+    MapTile *tiles;
+    unsigned int count, capacity;
+};
+
 /**
  * An Uncopyable has no default copy constructor of operator=.  A subclass may derive from
  * Uncopyable at any level of visibility, even private, and subclasses will not have a default copy
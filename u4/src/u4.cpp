@@ -17,15 +17,18 @@
 #include "error.h"
 #include "event.h"
 #include "game.h"
+#include "imagemgr.h"
 #include "intro.h"
 #include "music.h"
 #include "person.h"
+#include "profiler.h"
 #include "progress_bar.h"
 #include "screen.h"
 #include "settings.h"
 #include "sound.h"
 #include "tileset.h"
 #include "utils.h"
+#include "workqueue.h"
 
 #if defined(MACOSX)
 #include "macosx/osxinit.h"
@@ -37,8 +40,6 @@ bool quit = false;
 bool useProfile = false;
 string profileName = "";
 
-Performance perf("debug/performance.txt");
-
 using namespace std;
 
 
@@ -123,56 +124,83 @@ int main(int argc, char *argv[]) {
 
     xu4_srandom();
 
-    perf.start();
-    screenInit();
-    ProgressBar pb((320/2) - (200/2), (200/2), 200, 10, 0, (skipIntro ? 4 : 7));
+    profiler->setEnabled(settings.debug);
+    profiler->nameThread("main");
+
+    {
+        PROFILE_ZONE("screenInit()");
+        screenInit();
+
+        /* decode the images needed first in the background while the rest loads */
+        const char *startupImages[] = {
+            BKGD_SHAPES, BKGD_CHARSET, BKGD_BORDERS
+        };
+        const char *introImages[] = {
+            BKGD_OPTIONS_TOP, BKGD_OPTIONS_BTM, BKGD_TREE, BKGD_PORTAL,
+            BKGD_OUTSIDE, BKGD_INSIDE, BKGD_WAGON, BKGD_GYPSY, BKGD_ABACUS,
+            BKGD_HONCOM, BKGD_VALJUS, BKGD_SACHONOR, BKGD_SPIRHUM, BKGD_ANIMATE
+        };
+        std::vector<std::string> preloads(startupImages, startupImages + sizeof(startupImages) / sizeof(startupImages[0]));
+        if (!skipIntro)
+            preloads.insert(preloads.end(), introImages, introImages + sizeof(introImages) / sizeof(introImages[0]));
+        imageMgr->preload(preloads);
+    }
+
+    ProgressBar pb((320/2) - (200/2), (200/2), 200, 10, 0, (skipIntro ? 4 : 7) + imageMgr->numPreloads());
     pb.setBorderColor(240, 240, 240);
     pb.setColor(0, 0, 128);
     pb.setBorderWidth(1);
 
     screenTextAt(15, 11, "Loading...");
     screenRedrawScreen();
-    perf.end("Screen Initialization");
     ++pb;
 
-    perf.start();
-    soundInit();
-    perf.end("Misc Initialization");
+    {
+        PROFILE_ZONE("soundInit()");
+        soundInit();
+    }
     ++pb;
 
-    perf.start();
-    Tileset::loadAll();
-    perf.end("Tileset::loadAll()");
+    {
+        PROFILE_ZONE("Tileset::loadAll()");
+        Tileset::loadAll();
+    }
     ++pb;
 
-    perf.start();
-    creatureMgr->getInstance();
-    perf.end("creatureMgr->getInstance()");
+    {
+        PROFILE_ZONE("creatureMgr->getInstance()");
+        creatureMgr->getInstance();
+    }
     ++pb;
 
+    {
+        PROFILE_ZONE("imageMgr->finishPreload()");
+        while (imageMgr->finishPreload())
+            ++pb;
+    }
+
     intro = new IntroController();
     if (!skipIntro)
     {
         /* do the intro */
-        perf.start();
-        intro->init();
-        perf.end("introInit()");
+        {
+            PROFILE_ZONE("introInit()");
+            intro->init();
+        }
         ++pb;
 
-        perf.start();
-        intro->preloadMap();
-        perf.end("intro->preloadMap()");
+        {
+            PROFILE_ZONE("intro->preloadMap()");
+            intro->preloadMap();
+        }
         ++pb;
 
-        perf.start();
-        musicMgr->init();
-        perf.end("musicMgr->init()");
+        {
+            PROFILE_ZONE("musicMgr->init()");
+            musicMgr->init();
+        }
         ++pb;
 
-        /* give a performance report */
-        if (settings.debug)
-            perf.report();
-
         eventHandler->pushController(intro);
         eventHandler->run();
         eventHandler->popController();
@@ -183,17 +211,12 @@ int main(int argc, char *argv[]) {
     if (quit)
         return 0;
 
-    perf.reset();
-
     /* play the game! */
-    perf.start();
-    game = new GameController();
-    game->init();
-    perf.end("gameInit()");
-    
-    /* give a performance report */
-    if (settings.debug)
-        perf.report("\n===============================\n\n");
+    {
+        PROFILE_ZONE("gameInit()");
+        game = new GameController();
+        game->init();
+    }
 
     eventHandler->pushController(game);
     eventHandler->run();
@@ -204,6 +227,7 @@ int main(int argc, char *argv[]) {
     delete musicMgr;
     soundDelete();
     screenDelete();
+    WorkQueue::destroy();
 
     return 0;
 }
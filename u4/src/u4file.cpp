@@ -4,6 +4,7 @@
 
 #include <cctype>
 #include <cstdlib>
+#include <sys/stat.h>
 
 #include "u4file.h"
 #include "unzip.h"
@@ -32,6 +33,7 @@ public:
     virtual int getc();
     virtual int putc(int c);
     virtual long length();
+    virtual unsigned long stamp();
 
 private:
     FILE *file;
@@ -52,6 +54,7 @@ public:
     virtual int getc();
     virtual int putc(int c);
     virtual long length();
+    virtual unsigned long stamp();
 
 private:
     unzFile zfile;
@@ -403,6 +406,17 @@ long U4FILE_stdio::length() {
     return len;
 }
 
+/**
+ * Uses the file's modification time as its stamp.
+ */
+unsigned long U4FILE_stdio::stamp() {
+    struct stat st;
+
+    if (fstat(fileno(file), &st) != 0)
+        return 0;
+    return (unsigned long) st.st_mtime;
+}
+
 /**
  * Opens a file from within a zip archive.
  */
@@ -446,6 +460,8 @@ int U4FILE_zip::seek(long offset, int whence) {
         unzCloseCurrentFile(zfile);
         unzOpenCurrentFile(zfile);
         pos = 0;
+        if (offset == 0)
+            return 0;
     }
     ASSERT(offset - pos > 0, "error in U4FILE_zip::seek");
     buf = new char[offset - pos];
@@ -493,6 +509,19 @@ long U4FILE_zip::length() {
     return fileinfo.uncompressed_size;
 }
 
+/**
+ * Uses the CRC the zip archive keeps for the file as its stamp.
+ */
+unsigned long U4FILE_zip::stamp() {
+    unz_file_info fileinfo;
+
+    unzGetCurrentFileInfo(zfile, &fileinfo,
+                          NULL, 0,
+                          NULL, 0,
+                          NULL, 0);
+    return fileinfo.crc;
+}
+
 /**
  * Open a data file from the Ultima 4 for DOS installation.  This
  * function checks the various places where it can be installed, and
@@ -607,6 +636,16 @@ long u4flength(U4FILE *f) {
     return f->length();
 }
 
+/**
+ * Returns a number that changes whenever the contents of a file do,
+ * without reading the file: its modification time if it is a plain
+ * file, or its CRC if it is in a zip archive.  Together with the
+ * length, this is enough to tell whether a file has been replaced.
+ */
+unsigned long u4fstamp(U4FILE *f) {
+    return f->stamp();
+}
+
 /**
  * Read a series of zero terminated strings from a file.  The strings
  * are read from the given offset, or the current file position if
@@ -71,6 +71,7 @@ public:
     virtual int getc() = 0;
     virtual int putc(int c) = 0;
     virtual long length() = 0;
+    virtual unsigned long stamp() = 0;
 
     int getshort();
 };
@@ -113,6 +114,7 @@ int u4fgetc(U4FILE *f);
 int u4fgetshort(U4FILE *f);
 int u4fputc(int c, U4FILE *f);
 long u4flength(U4FILE *f);
+unsigned long u4fstamp(U4FILE *f);
 std::vector<std::string> u4read_stringtable(U4FILE *f, long offset, int nstrings);
 
 std::string u4find_path(const std::string &fname, std::list<std::string> specificSubPaths);
@@ -0,0 +1,77 @@
+/*
+ * $Id$
+ */
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <deque>
+#include <vector>
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+#define WORKQUEUE_MAX_WORKERS 8
+
+/**
+ * A piece of work that can be handed to the WorkQueue.  Whoever adds
+ * a job owns it, and must wait for it before deleting it.
+ */
+class Job {
+public:
+    Job() : state(JOB_IDLE) {}
+    virtual ~Job() {}
+
+    /** Does the work.  Runs on a worker thread, or on the thread waiting for the job. */
+    virtual void run() = 0;
+
+private:
+    friend class WorkQueue;
+
+    enum State {
+        JOB_IDLE,
+        JOB_QUEUED,
+        JOB_RUNNING,
+        JOB_DONE
+    };
+
+    State state;
+};
+
+/**
+ * A pool of worker threads that run jobs in the order they were
+ * added.  Waiting on a job nobody has started yet runs it right away
+ * on the waiting thread, so a wait never sits behind the rest of the
+ * queue.
+ */
+class WorkQueue {
+public:
+    static WorkQueue *getInstance();
+    static void destroy();
+
+    void add(Job *job);
+    void wait(Job *job);
+    bool isDone(Job *job);
+    int numWorkers() const;
+
+private:
+    WorkQueue();
+    ~WorkQueue();
+
+    static int workerMain(void *data);
+    void runJob(Job *job);
+
+    static WorkQueue *instance;
+
+    std::deque<Job *> queue;
+    std::vector<SDL_Thread *> workers;
+    SDL_mutex *mutex;
+    SDL_cond *workAdded;    /**< signalled when a job is queued or the workers should stop */
+    SDL_cond *jobDone;      /**< broadcast whenever any job finishes */
+    bool stopping;
+};
+
+#define workQueue (WorkQueue::getInstance())
+
+#endif /* WORKQUEUE_H */
@@ -0,0 +1,176 @@
+/*
+ * $Id$
+ */
+
+#include "vc6.h" // Fixes things if you're using VC6, does nothing if otherwise
+
+#include <SDL.h>
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "workqueue.h"
+
+#include "debug.h"
+#include "error.h"
+#include "profiler.h"
+
+WorkQueue *WorkQueue::instance = NULL;
+
+/**
+ * Returns the number of processors available, or 1 if that can't be
+ * found out.
+ */
+static int workQueueCpuCount() {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+#else
+    return 1;
+#endif
+}
+
+WorkQueue *WorkQueue::getInstance() {
+    if (instance == NULL)
+        instance = new WorkQueue();
+    return instance;
+}
+
+/**
+ * Stops the workers.  Jobs that were never started are dropped, so
+ * their owners must have waited on them first.
+ */
+void WorkQueue::destroy() {
+    if (instance != NULL) {
+        delete instance;
+        instance = NULL;
+    }
+}
+
+/**
+ * Starts a worker for every processor but the one the game runs on,
+ * which does its share of the work when it waits on a job.
+ */
+WorkQueue::WorkQueue() : stopping(false) {
+    mutex = SDL_CreateMutex();
+    workAdded = SDL_CreateCond();
+    jobDone = SDL_CreateCond();
+
+    int n = std::min(std::max(workQueueCpuCount() - 1, 1), WORKQUEUE_MAX_WORKERS);
+    for (int i = 0; i < n; i++) {
+        SDL_Thread *thread = SDL_CreateThread(&WorkQueue::workerMain, this);
+        if (!thread) {
+            errorWarning("%s", SDL_GetError());
+            break;
+        }
+        workers.push_back(thread);
+    }
+}
+
+WorkQueue::~WorkQueue() {
+    SDL_mutexP(mutex);
+    stopping = true;
+    SDL_CondBroadcast(workAdded);
+    SDL_mutexV(mutex);
+
+    for (std::vector<SDL_Thread *>::iterator i = workers.begin(); i != workers.end(); i++)
+        SDL_WaitThread(*i, NULL);
+
+    SDL_DestroyCond(jobDone);
+    SDL_DestroyCond(workAdded);
+    SDL_DestroyMutex(mutex);
+}
+
+/**
+ * Queues a job to be run by the next free worker.
+ */
+void WorkQueue::add(Job *job) {
+    SDL_mutexP(mutex);
+    ASSERT(job->state == Job::JOB_IDLE || job->state == Job::JOB_DONE, "job added to the work queue twice");
+    job->state = Job::JOB_QUEUED;
+    queue.push_back(job);
+    SDL_CondSignal(workAdded);
+    SDL_mutexV(mutex);
+}
+
+/**
+ * Returns once the job has finished.  If no worker has picked the job
+ * up yet, it is taken off the queue and run here instead.
+ */
+void WorkQueue::wait(Job *job) {
+    SDL_mutexP(mutex);
+
+    if (job->state == Job::JOB_QUEUED) {
+        queue.erase(std::find(queue.begin(), queue.end(), job));
+        job->state = Job::JOB_RUNNING;
+        SDL_mutexV(mutex);
+        runJob(job);
+        return;
+    }
+
+    while (job->state == Job::JOB_RUNNING)
+        SDL_CondWait(jobDone, mutex);
+
+    SDL_mutexV(mutex);
+}
+
+/**
+ * Returns true if the job has finished, without waiting for it.
+ */
+bool WorkQueue::isDone(Job *job) {
+    SDL_mutexP(mutex);
+    bool done = job->state == Job::JOB_DONE;
+    SDL_mutexV(mutex);
+    return done;
+}
+
+int WorkQueue::numWorkers() const {
+    return workers.size();
+}
+
+int WorkQueue::workerMain(void *data) {
+    WorkQueue *wq = static_cast<WorkQueue *>(data);
+    profiler->nameThread("worker");
+
+    SDL_mutexP(wq->mutex);
+    while (true) {
+        while (wq->queue.empty() && !wq->stopping)
+            SDL_CondWait(wq->workAdded, wq->mutex);
+        if (wq->stopping)
+            break;
+
+        Job *job = wq->queue.front();
+        wq->queue.pop_front();
+        job->state = Job::JOB_RUNNING;
+        SDL_mutexV(wq->mutex);
+
+        wq->runJob(job);
+
+        SDL_mutexP(wq->mutex);
+    }
+    SDL_mutexV(wq->mutex);
+
+    return 0;
+}
+
+/**
+ * Runs a job that has just been taken off the queue and marked as
+ * running, then lets anyone waiting on it know that it's done.
+ */
+void WorkQueue::runJob(Job *job) {
+    job->run();
+
+    SDL_mutexP(mutex);
+    job->state = Job::JOB_DONE;
+    SDL_CondBroadcast(jobDone);
+    SDL_mutexV(mutex);
+}
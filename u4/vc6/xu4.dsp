@@ -328,6 +328,14 @@ SOURCE=..\src\image_sdl.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\imagecache.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\imagecache.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\imageloader.cpp
 # End Source File
 # Begin Source File
@@ -384,6 +392,14 @@ SOURCE=..\src\item.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\latency.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\latency.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\location.cpp
 # End Source File
 # Begin Source File
@@ -392,6 +408,14 @@ SOURCE=..\src\location.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\los.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\los.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\map.cpp
 # End Source File
 # Begin Source File
@@ -496,6 +520,14 @@ SOURCE=..\src\portal.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\profiler.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\profiler.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\progress_bar.cpp
 # End Source File
 # Begin Source File
@@ -592,6 +624,14 @@ SOURCE=..\src\textcolor.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\textlayout.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\textlayout.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\textview.cpp
 # End Source File
 # Begin Source File
@@ -696,6 +736,14 @@ SOURCE=..\src\weapon.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\workqueue_sdl.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\workqueue.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\xml.cpp
 # End Source File
 # Begin Source File